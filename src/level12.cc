@@ -1,17 +1,12 @@
 #include <array>
 #include <boost/container_hash/hash.hpp>
 #include <cassert>
+#include <cstdint>
 #include <iostream>
-#include <map>
 #include <numeric>
 #include <regex>
-
-enum
-{
-    TEST_X = 0x1,
-    TEST_Y = 0x2,
-    TEST_Z = 0x4
-};
+#include <thread>
+#include <vector>
 
 struct XYZ
 {
@@ -42,14 +37,6 @@ struct Asteroid
 {
     bool operator==(Asteroid const& o) const noexcept { return position == o.position && velocity == o.velocity; }
 
-    unsigned eq(Asteroid const& o) {
-        unsigned result = 0;
-        if (position.x == o.position.x && velocity.x == o.velocity.x) { result |= TEST_X; }
-        if (position.y == o.position.y && velocity.y == o.velocity.y) { result |= TEST_Y; }
-        if (position.z == o.position.z && velocity.z == o.velocity.z) { result |= TEST_Z; }
-        return result;
-    }
-
     void move() { position += velocity; }
 
     void update_velocity(Asteroid& o)
@@ -188,30 +175,64 @@ long lcm(std::vector<long> arr)
     return g;
 }
 
-unsigned long part2(Asteroids asteroids)
+// One axis of all the moons, positions and velocities in separate arrays.
+// The axes never affect each other, so each one finds its own period.
+struct Axis
 {
-    const Asteroids orig = asteroids;
-
-    std::map<unsigned, long> steps;
+    std::array<int32_t, 4> pos {}, vel {};
 
-    for (unsigned long i = 1, j = 0; j < 3; ++i) {
-        update_velocity(asteroids);
-
-        for (auto& a : asteroids) {
-            a.move();
-        }
+    bool operator==(Axis const& o) const noexcept = default;
 
-        const unsigned eq = asteroids[0].eq(orig[0]);
-        if ((eq == TEST_X || eq == TEST_Y || eq == TEST_Z) && eq == asteroids[1].eq(orig[1])
-            && eq == asteroids[2].eq(orig[2]) && eq == asteroids[3].eq(orig[3]))
-        {
-            if (steps.insert({eq, i}).second) {
-                ++j;
+    // gravity is the sign of the difference, no branches
+    void step() noexcept
+    {
+        std::array<int32_t, 4> dv {};
+        for (size_t i = 0; i < 4; ++i) {
+            for (size_t j = 0; j < 4; ++j) {
+                dv[i] += (pos[j] > pos[i]) - (pos[j] < pos[i]);
             }
         }
+        for (size_t i = 0; i < 4; ++i) {
+            vel[i] += dv[i];
+            pos[i] += vel[i];
+        }
+    }
+
+    // steps until the axis is back where it started
+    long period() const noexcept
+    {
+        Axis a = *this;
+        long steps = 0;
+        do {
+            a.step();
+            ++steps;
+        } while (!(a == *this));
+        return steps;
+    }
+};
+
+
+unsigned long part2(Asteroids const& asteroids)
+{
+    std::array<Axis, 3> axes;
+    for (size_t i = 0; i < 4; ++i) {
+        XYZ const& p = asteroids[i].position;
+        XYZ const& v = asteroids[i].velocity;
+        axes[0].pos[i] = p.x, axes[0].vel[i] = v.x;
+        axes[1].pos[i] = p.y, axes[1].vel[i] = v.y;
+        axes[2].pos[i] = p.z, axes[2].vel[i] = v.z;
+    }
+
+    std::array<long, 3> periods {};
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < axes.size(); ++i) {
+        threads.emplace_back([&, i] { periods[i] = axes[i].period(); });
+    }
+    for (auto& t : threads) {
+        t.join();
     }
 
-    return lcm({steps.at(1), steps.at(2), steps.at(4)});
+    return lcm({periods.begin(), periods.end()});
 }
 
 int main()
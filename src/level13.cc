@@ -4,9 +4,13 @@
 
 #include <algorithm>
 #include <array>
+#include <cassert>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <list>
 #include <map>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -21,6 +25,7 @@ enum class Ret : int {
 };
 
 struct Param;
+struct Journal;
 
 struct Unit {
     int64_t ip = 0;
@@ -29,6 +34,9 @@ struct Unit {
     Program program;
     IO io;
 
+    uint64_t steps = 0;         // executed instructions
+    Journal* journal = nullptr; // records the consumed inputs when set
+
     Ret run();
 
 protected:
@@ -80,6 +88,37 @@ private:
     const char _mode;
 };
 
+// Consumed inputs of a session together with the instruction count at which
+// they were read, stored as LEB128 varints (step delta, zigzag value). The
+// game plays itself, so a session is only ever replayed from the start;
+// checkpoints to jump into a session are in level25's journal.
+struct Journal
+{
+    struct Entry
+    {
+        uint64_t step = 0;
+        int64_t value = 0;
+    };
+
+    struct Cursor
+    {
+        size_t index = 0, pos = 0;
+        uint64_t step = 0;
+    };
+
+    void record(uint64_t step, int64_t value);
+    bool next(Cursor& cur, Entry& e) const;
+
+    size_t size() const { return end.index; }
+
+    void save(std::string const& path) const;
+    static std::optional<Journal> load(std::string const& path);
+
+protected:
+    std::string log;
+    Cursor end;
+};
+
 // template<typename T> class TD;
 
 int64_t Unit::get_val(int64_t _ip)
@@ -111,7 +150,7 @@ void Unit::set_param(int64_t _ip, int64_t value)
 Ret Unit::run()
 {
     try {
-        for (;;) {
+        for (;; ++steps) {
             auto s = std::to_string(program.at(ip));
             std::reverse(std::begin(s), std::end(s));
             while (s.size() < 5) {
@@ -133,12 +172,14 @@ Ret Unit::run()
                 ip += 4;
             } else if (cmd == "30") {
                 if (io.empty()) { return Ret::INPUT; }
+                if (journal) { journal->record(steps, io.back()); }
                 p1.set(io.back());
                 io.pop_back();
                 ip += 2;
             } else if (cmd == "40") {
                 io.push_front(p1());
                 ip += 2;
+                ++steps;
                 return Ret::OUTPUT;
             } else if (cmd == "50") {  // jump-if-true
                 if (p1()) {
@@ -174,6 +215,79 @@ Ret Unit::run()
     }
 }
 
+void Journal::record(uint64_t step, int64_t value)
+{
+    auto put = [this](uint64_t v) {
+        for (; v >= 0x80; v >>= 7) {
+            log.push_back(static_cast<char>(v | 0x80));
+        }
+        log.push_back(static_cast<char>(v));
+    };
+
+    assert(step >= end.step);
+    put(step - end.step);
+    put((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    end.step = step;
+    end.pos = log.size();
+    ++end.index;
+}
+
+// false at the end of the log and on a cut off or overlong varint, the
+// cursor only moves over complete entries
+bool Journal::next(Cursor& cur, Entry& e) const
+{
+    Cursor at = cur;
+    auto get = [this, &at](uint64_t& v) -> bool {
+        v = 0;
+        for (unsigned shift = 0; shift < 64 && at.pos < log.size(); shift += 7) {
+            const auto b = static_cast<unsigned char>(log[at.pos++]);
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    uint64_t delta, z;
+    if (!get(delta) || !get(z)) {
+        return false;
+    }
+    at.step += delta;
+    e.step = at.step;
+    e.value = static_cast<int64_t>(z >> 1) ^ -static_cast<int64_t>(z & 1);
+    ++at.index;
+    cur = at;
+    return true;
+}
+
+void Journal::save(std::string const& path) const
+{
+    std::ofstream fw(path, std::ios::binary);
+    fw.write(log.data(), log.size());
+}
+
+std::optional<Journal> Journal::load(std::string const& path)
+{
+    std::ifstream fr(path, std::ios::binary);
+    if (!fr) {
+        std::cerr << "Can't read journal " << path << std::endl;
+        return std::nullopt;
+    }
+
+    Journal journal;
+    journal.log.assign(std::istreambuf_iterator<char>(fr), std::istreambuf_iterator<char>());
+
+    for (Entry e; journal.next(journal.end, e);) {
+    }
+    if (journal.end.pos != journal.log.size()) {
+        std::cerr << "Journal " << path << " is cut off or malformed after input " << journal.end.index << std::endl;
+        return std::nullopt;
+    }
+    return journal;
+}
+
+
 struct Point {
     int64_t x = 0, y = 0;
 
@@ -287,10 +401,11 @@ int64_t run_part1(Unit unit) {
 }
 
 
-int64_t run_part2(Unit unit) {
+int64_t run_part2(Unit unit, Journal* journal = nullptr) {
     Mapa mapa;
 
     unit.program[0] = 2; // play for free
+    unit.journal = journal;
 
     int64_t score = 0;
 
@@ -346,6 +461,43 @@ int64_t run_part2(Unit unit) {
 }
 
 
+// Play the recorded joystick moves back, only the score is tracked. Fails
+// when the log ends early or an input is asked for at another step.
+std::optional<int64_t> replay_part2(Unit unit, Journal const& journal) {
+    unit.program[0] = 2; // play for free
+
+    int64_t score = 0;
+
+    Journal::Cursor cur;
+    Journal::Entry e;
+
+    for (;;) {
+        auto res = unit.run();
+        if (res == Ret::EXIT) {
+            break;
+        } else if (res == Ret::INPUT) {
+            if (!journal.next(cur, e) || e.step != unit.steps) {
+                std::cerr << "Journal ended early or drifted at input " << cur.index << std::endl;
+                return std::nullopt;
+            }
+            unit.io.push_front(e.value);
+        } else if (res == Ret::OUTPUT) {
+            if (unit.io.size() < 3) {
+                continue;
+            }
+            int64_t x = unit.io.back(); unit.io.pop_back();
+            int64_t y = unit.io.back(); unit.io.pop_back();
+            int64_t tile = unit.io.back(); unit.io.pop_back();
+            if (x == -1 && y == 0) {
+                score = tile;
+            }
+        }
+    }
+
+    return score;
+}
+
+
 int main(int argc, char* argv[])
 {
     std::string line;
@@ -366,11 +518,37 @@ int main(int argc, char* argv[])
         }
     }
 
+    // -w FILE records the part 2 session, -r FILE replays it instead of playing
+    std::string record, replay;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string opt {argv[i]};
+        if (opt == "-w") {
+            record = argv[i + 1];
+        } else if (opt == "-r") {
+            replay = argv[i + 1];
+        }
+    }
+
+    if (!replay.empty()) {
+        auto journal = Journal::load(replay);
+        auto r2 = journal ? replay_part2(unit, *journal) : std::nullopt;
+        if (!r2) {
+            return 1;
+        }
+        std::cout << "2: " << *r2 << "\n";
+        return 0;
+    }
+
     auto r1 = run_part1(unit);
     std::cout << "1: " << r1 << "\n";
 
-    auto r2 = run_part2(unit);
+    Journal journal;
+    auto r2 = run_part2(unit, record.empty() ? nullptr : &journal);
     std::cout << "2: " << r2 << "\n";
 
+    if (!record.empty()) {
+        journal.save(record);
+    }
+
     return 0;
 }
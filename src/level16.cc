@@ -1,9 +1,18 @@
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
 #include <cstring>
+#include <immintrin.h>
 #include <iostream>
 #include <iterator>
+#include <string>
+#include <string_view>
+#include <tbb/blocked_range.h>
 #include <tbb/concurrent_queue.h>
 #include <tbb/concurrent_vector.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
 #include <vector>
 
 size_t to_int(char c)
@@ -19,130 +28,330 @@ char to_char(size_t num)
     return '0' + num;
 }
 
-struct PatternIterator
+// Output digit `index` uses the pattern 0, 1, 0, -1 with every element
+// repeated index + 1 times, i.e. alternating blocks of +1 and -1 of that
+// length. With prefix sums every block is a single subtraction, so a phase
+// costs n/1 + n/2 + ... = O(n log n).
+std::string process(std::string signal, size_t offset = 0)
 {
-    enum OP
-    {
-        MINUS = -1,
-        SKIP = 0,
-        PLUS = 1,
+    const auto sig_size = signal.size();
+
+    for (auto& c : signal) {
+        c = to_int(c);
+    }
+
+    // prefix[i] is the sum of signal[0, i)
+    std::vector<long long> prefix(sig_size + 1, 0);
+
+    auto block = [&prefix, sig_size](size_t from, size_t len) -> long long {
+        from = std::min(from, sig_size);
+        return prefix[std::min(from + len, sig_size)] - prefix[from];
     };
 
-    // static const Pattern base_pattern = {0, 1, 0, -1};
-    PatternIterator(size_t _index, size_t _size)
-        : repeat {_index + 1}
-        , size {_size}
-        , pattern_size {4 * repeat}
-        , input_pos {_index}
-        , pattern_pos {(1 + _index) % pattern_size}
-    {
-        assert(get().second == PLUS);
+    for (unsigned iteration = 0; iteration < 100; ++iteration) {
+        for (size_t index = 0; index < sig_size; ++index) {
+            prefix[index + 1] = prefix[index] + signal[index];
+        }
+
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, sig_size), [&](auto const& range) {
+            for (size_t index = range.begin(); index < range.end(); ++index) {
+                const size_t repeat = index + 1;
+                long long num = 0;
+                for (size_t pos = index; pos < sig_size; pos += 4 * repeat) {
+                    num += block(pos, repeat) - block(pos + 2 * repeat, repeat);
+                }
+                signal[index] = std::abs(num) % 10;
+            }
+        });
     }
 
+    for (auto& c : signal) {
+        c = to_char(c);
+    }
+    return signal;
+}
 
-    bool end() const noexcept
-    {
-        return input_pos >= size;
+// One phase over the second half of the signal: every digit becomes the sum
+// of itself and all the digits after it. Works in place on [first, last),
+// `carry` is the sum of everything after `last`, the new first digit is returned.
+unsigned suffix_phase_scalar(char* first, char* last, unsigned carry)
+{
+    while (last != first) {
+        --last;
+        carry = (carry + *last) % 10;
+        *last = carry;
     }
+    return carry;
+}
+
+// The same with 16 digits per step: suffix sums inside the block in int16
+// lanes, plus the carry from the blocks after it. Everything stays below 160,
+// so a single multiply-high reduction mod 10 per block is enough.
+__attribute__((target("avx2"))) unsigned suffix_phase_avx2(char* first, char* last, unsigned carry)
+{
+    const __m256i broadcast = _mm256_setr_epi8(
+        0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1);
+    const __m256i div10 = _mm256_set1_epi16(6554);
+    const __m256i ten = _mm256_set1_epi16(10);
+
+    for (; last - first >= 16; last -= 16) {
+        char* block = last - 16;
+        __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block)));
+
+        // suffix sums within each 128bit lane
+        v = _mm256_add_epi16(v, _mm256_srli_si256(v, 2));
+        v = _mm256_add_epi16(v, _mm256_srli_si256(v, 4));
+        v = _mm256_add_epi16(v, _mm256_srli_si256(v, 8));
+
+        // the low lane also gets the total of the high lane
+        __m256i hi = _mm256_permute2x128_si256(v, v, 0x81);
+        v = _mm256_add_epi16(v, _mm256_shuffle_epi8(hi, broadcast));
+        v = _mm256_add_epi16(v, _mm256_set1_epi16(carry));
+
+        const __m256i q = _mm256_mulhi_epu16(v, div10);
+        v = _mm256_sub_epi16(v, _mm256_mullo_epi16(q, ten));
+
+        carry = _mm256_extract_epi16(v, 0);
 
-    std::pair<size_t, OP> get() const noexcept
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0xD8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(block), _mm256_castsi256_si128(packed));
+    }
+
+    return suffix_phase_scalar(first, last, carry);
+}
+
+using SuffixPhase = unsigned (*)(char*, char*, unsigned);
+
+SuffixPhase suffix_phase()
+{
+    return __builtin_cpu_supports("avx2") ? suffix_phase_avx2 : suffix_phase_scalar;
+}
+
+// Two pass block scan: the digit sums of all blocks in parallel, then the
+// carries into each block serially, then every block scanned in parallel.
+void suffix_phase_parallel(char* first, char* last, SuffixPhase phase, std::vector<unsigned>& carries)
+{
+    constexpr size_t MIN_BLOCK = 1 << 16;
+
+    const size_t size = last - first;
+    const size_t blocks = std::clamp<size_t>(size / MIN_BLOCK, 1, 4 * tbb::this_task_arena::max_concurrency());
+    if (blocks == 1) {
+        phase(first, last, 0);
+        return;
+    }
+
+    auto bound = [=](size_t b) { return first + size * b / blocks; };
+
+    carries.resize(blocks);
+    tbb::parallel_for(size_t {0}, blocks, [&](size_t b) {
+        unsigned sum = 0;
+        for (auto it = bound(b); it != bound(b + 1); ++it) {
+            sum += *it;
+        }
+        carries[b] = sum % 10;
+    });
+
+    for (unsigned acc = 0, b = blocks; b-- > 0;) {
+        std::swap(acc, carries[b]);
+        acc = (acc + carries[b]) % 10;
+    }
+
+    tbb::parallel_for(size_t {0}, blocks, [&](size_t b) {
+        phase(bound(b), bound(b + 1), carries[b]);
+    });
+}
+
+// The input repeated `times` times without materialising it, digits are
+// produced on demand and only the needed tail is ever allocated.
+struct RepeatedSignal
+{
+    RepeatedSignal(std::string_view _signal, size_t _times)
+        : signal {_signal}
+        , times {_times}
+    { }
+
+    size_t size() const noexcept
     {
-        switch ((pattern_pos / repeat) % 4) {
-        case 0:  // skip1
-        case 2:  // skip2
-            return {input_pos, SKIP};
-        case 1:  // plus
-            return {input_pos, PLUS};
-        case 3:  // minus
-            return {input_pos, MINUS};
-        };
-        assert(false);
-    }
-
-    bool next() noexcept
+        return signal.size() * times;
+    }
+
+    // digits [from, size()) as values 0-9
+    std::string tail(size_t from) const
     {
-        assert(get().second != SKIP);
-        ++input_pos;
-        ++pattern_pos;
-        if (pattern_pos == pattern_size) {
-            pattern_pos = 0;
+        assert(from <= size());
+        std::string digits;
+        digits.reserve(size() - from);
+        for (size_t pos = from % signal.size(); digits.size() < size() - from; pos = 0) {
+            digits.append(signal.substr(pos, size() - from - digits.size()));
         }
-        if (get().second == SKIP) {
-            input_pos += repeat;
-            pattern_pos += repeat;
-            if (pattern_pos >= pattern_size) {
-                pattern_pos = pattern_pos % pattern_size;
-            }
+        for (auto& c : digits) {
+            c = to_int(c);
         }
-        return !end();
+        return digits;
     }
 
 protected:
-    const size_t repeat;
-    const size_t size;
-    const size_t pattern_size;
-
-    size_t input_pos;
-    size_t pattern_pos;
+    std::string_view signal;
+    size_t times;
 };
 
-std::string process(std::string signal, size_t offset = 0)
+// Digits of the signal after `offset` once the phases are done.
+std::string process2(RepeatedSignal const& signal, size_t offset, SuffixPhase phase = suffix_phase())
 {
-    const auto sig_size = signal.size();
+    assert(2 * offset >= signal.size());
 
-    for (auto& c : signal) {
-        c = to_int(c);
-    }
+    auto digits = signal.tail(offset);
 
+    std::vector<unsigned> carries;
     for (unsigned iteration = 0; iteration < 100; ++iteration) {
-        std::string new_signal(signal.begin(), signal.end());
+        suffix_phase_parallel(digits.data(), digits.data() + digits.size(), phase, carries);
+    }
 
-        for (size_t index = 0; index < sig_size; ++index) {
-            PatternIterator pi(index, sig_size);
-            long long num = 0;
-            do {
-                auto it = pi.get();
-                num += signal.at(it.first) * it.second;
-            } while (pi.next());
-
-            char& c = new_signal[index];
-            c = (std::abs(num) % 10);
+    for (auto& c : digits) {
+        c = to_char(c);
+    }
+    return digits;
+}
+
+// Throughput of the phase kernels over the part 2 tail, next to the phase
+// this replaced: a copy of the whole signal and a checked suffix sum.
+void benchmark(std::string signal, size_t times)
+{
+    const unsigned long offset = std::stol(signal.substr(0, 7));
+    const auto digits = RepeatedSignal(signal, times).tail(offset);
+
+    auto measure = [&digits](const char* name, unsigned rounds, auto&& phase) {
+        const auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < rounds; ++i) {
+            phase();
         }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        const double bytes = double(digits.size()) * rounds;
+        std::cout << name << ":\t" << bytes / elapsed.count() / 1e9 << " GB/s\n";
+    };
 
-        std::swap(signal, new_signal);
+    std::string whole;
+    whole.reserve(signal.size() * times);
+    for (size_t i = 0; i < times; ++i) {
+        whole += signal;
     }
+    for (auto& c : whole) {
+        c = to_int(c);
+    }
+    measure("copy", 100, [&whole, offset] {
+        std::string new_signal(whole.begin(), whole.end());
+        size_t num = 0;
+        for (size_t index = whole.size() - 1; index >= offset; --index) {
+            num += whole.at(index);
+            new_signal[index] = num % 10;
+        }
+        std::swap(whole, new_signal);
+    });
 
-    for (auto& c : signal) {
-        c = to_char(c);
+    std::string work {digits};
+    measure("scalar", 1000, [&work] { suffix_phase_scalar(work.data(), work.data() + work.size(), 0); });
+    if (__builtin_cpu_supports("avx2")) {
+        measure("avx2", 1000, [&work] { suffix_phase_avx2(work.data(), work.data() + work.size(), 0); });
     }
-    return signal;
 }
 
-std::string process2(std::string signal, size_t offset)
+
+// C(n, k) mod 10 from Lucas' theorem mod 2 and mod 5, combined by CRT.
+unsigned binomial_mod10(size_t n, size_t k)
 {
-    const auto sig_size = signal.size();
+    static constexpr unsigned char C5[5][5] = {
+        {1, 0, 0, 0, 0}, {1, 1, 0, 0, 0}, {1, 2, 1, 0, 0}, {1, 3, 3, 1, 0}, {1, 4, 1, 4, 1}};
 
-    for (auto& c : signal) {
-        c = to_int(c);
+    const unsigned mod2 = (n & k) == k;
+
+    unsigned mod5 = 1;
+    for (; k && mod5; n /= 5, k /= 5) {
+        mod5 = mod5 * C5[n % 5][k % 5] % 5;
     }
 
-    for (unsigned iteration = 0; iteration < 100; ++iteration) {
-        std::string new_signal(signal.begin(), signal.end());
+    return (5 * mod2 + 6 * mod5) % 10;
+}
 
-        size_t num = 0;
-        for (size_t index = sig_size - 1; index >= offset; --index) {
-            num += signal.at(index);
-            char& c = new_signal[index];
-            c = num % 10;
+// sum(coef[k] * digits[k]) mod 10 for digits and coefficients 0-9
+unsigned dot_mod10_scalar(const uint8_t* coef, const uint8_t* digits, size_t len)
+{
+    // 81 per term, reduce before the 32bit sum could overflow
+    constexpr size_t BLOCK = 1 << 24;
+
+    uint32_t num = 0;
+    for (size_t from = 0; from < len; from += BLOCK) {
+        const size_t to = std::min(len, from + BLOCK);
+        uint32_t block = 0;
+        for (size_t k = from; k < to; ++k) {
+            block += coef[k] * digits[k];
         }
+        num = (num + block) % 10;
+    }
+    return num;
+}
 
-        std::swap(signal, new_signal);
+// The same 32 terms at a time: maddubs multiplies the bytes and adds pairs to
+// int16 (at most 162), madd adds those pairs again into int32 lanes.
+__attribute__((target("avx2"))) unsigned dot_mod10_avx2(const uint8_t* coef, const uint8_t* digits, size_t len)
+{
+    // at most 324 per lane and step
+    constexpr size_t BLOCK = size_t {1} << 22;
+
+    const __m256i ones = _mm256_set1_epi16(1);
+
+    uint32_t num = 0;
+    size_t k = 0;
+    while (len - k >= 32) {
+        const size_t to = k + std::min(BLOCK, (len - k) / 32) * 32;
+        __m256i acc = _mm256_setzero_si256();
+        for (; k < to; k += 32) {
+            const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(digits + k));
+            const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(coef + k));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(d, c), ones));
+        }
+
+        alignas(32) uint32_t lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+        for (const auto lane : lanes) {
+            num = (num + lane % 10) % 10;
+        }
     }
 
-    for (auto& c : signal) {
-        c = to_char(c);
+    return (num + dot_mod10_scalar(coef + k, digits + k, len - k)) % 10;
+}
+
+using DotMod10 = unsigned (*)(const uint8_t*, const uint8_t*, size_t);
+
+DotMod10 dot_mod10()
+{
+    return __builtin_cpu_supports("avx2") ? dot_mod10_avx2 : dot_mod10_scalar;
+}
+
+// In the second half of the signal a phase is a suffix sum, so after `phases`
+// of them digit i is sum(C(phases - 1 + k, k) * signal[i + k]). With the
+// coefficients precomputed any number of phases is a single pass.
+std::string process_binomial(RepeatedSignal const& signal, size_t offset, unsigned phases, size_t count = 8)
+{
+    assert(phases > 0);
+    assert(2 * offset >= signal.size());
+
+    const auto digits = signal.tail(offset);
+    const size_t tail = digits.size();
+
+    std::vector<uint8_t> coef(tail);
+    for (size_t k = 0; k < tail; ++k) {
+        coef[k] = binomial_mod10(phases - 1 + k, k);
     }
-    return signal;
+
+    const DotMod10 dot = dot_mod10();
+
+    std::string result;
+    for (size_t index = 0; index < count && index < tail; ++index) {
+        const auto* d = reinterpret_cast<const uint8_t*>(digits.data()) + index;
+        result.push_back(to_char(dot(coef.data(), d, tail - index)));
+    }
+    return result;
 }
 
 
@@ -152,33 +361,56 @@ void part_1(std::string signal)
     std::cout << "result_1:\t" << signal.substr(0, 8) << "\n";
 }
 
-void part_2(std::string signal)
+bool part_2(std::string signal, size_t times, bool simulate)
 {
     const unsigned long offset = std::stol(signal.substr(0, 7));
 
-    constexpr int MULTIPLY = 10000;
-
-    std::string long_signal;
-    long_signal.reserve(MULTIPLY * signal.size());
-
-    for (unsigned i = 0; i < MULTIPLY; ++i) {
-        std::copy(signal.begin(), signal.end(), std::back_inserter(long_signal));
+    const RepeatedSignal long_signal(signal, times);
+    if (2 * offset < long_signal.size() || offset >= long_signal.size()) {
+        std::cerr << "Offset " << offset << " is not in the second half of the signal repeated " << times
+                  << " times\n";
+        return false;
     }
 
-    long_signal = process2(long_signal, offset);
-    std::cout << "result_2:\t" << long_signal.substr(offset, 8) << "\n";
+    if (simulate) {
+        std::cout << "result_2:\t" << process2(long_signal, offset).substr(0, 8) << "\n";
+    } else {
+        std::cout << "result_2:\t" << process_binomial(long_signal, offset, 100) << "\n";
+    }
+    return true;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+    // -s runs all the part 2 phases instead of the closed form, -b measures the phase kernels,
+    // an optional number repeats the signal that many times for part 2 (10000 by default)
+    std::string mode;
+    size_t times = 10000;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg {argv[i]};
+        if (arg == "-s" || arg == "-b") {
+            mode = arg;
+        } else {
+            times = std::stoul(arg);
+        }
+    }
+    const bool simulate = mode == "-s";
+
     std::string signal;
     if (!std::getline(std::cin, signal)) {
         std::cerr << "Missing input\n";
         return 1;
     }
 
+    if (mode == "-b") {
+        benchmark(signal, times);
+        return 0;
+    }
+
     part_1(signal);
-    part_2(signal);
+    if (!part_2(signal, times, simulate)) {
+        return 1;
+    }
 
     return 0;
 }
@@ -12,6 +12,7 @@
 #include <list>
 #include <map>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -37,9 +38,19 @@ struct Unit
 
     Ret run();
 
+    // ASCII channel: whole lines in, whole screens out, without returning
+    // from the VM per character.
+    void feed(std::string_view line);
+    std::string_view read_until_prompt(size_t limit = 0);
+    Ret state = Ret::INPUT;
+
 protected:
     friend struct Param;
 
+    std::string ascii_in, ascii_out;
+    size_t ascii_pos = 0, ascii_limit = 0;
+    bool ascii = false;
+
     int64_t get_val(int64_t _ip);
     int64_t get_param(int64_t _ip, char mode);
     void set_param(int64_t _ip, int64_t value);
@@ -115,6 +126,29 @@ void Unit::set_param(int64_t _ip, int64_t value)
     program[_ip] = value;
 }
 
+void Unit::feed(std::string_view line)
+{
+    if (ascii_pos == ascii_in.size()) {
+        ascii_in.clear();
+        ascii_pos = 0;
+    }
+    ascii_in.append(line);
+    ascii_in.push_back('\n');
+}
+
+// Returns everything printed until the program wants more input. A non-ASCII
+// value (or hitting the limit) stops the run with state == Ret::OUTPUT, the
+// value itself is left in the regular output.
+std::string_view Unit::read_until_prompt(size_t limit)
+{
+    ascii_out.clear();
+    ascii_limit = limit;
+    ascii = true;
+    state = run();
+    ascii = false;
+    return ascii_out;
+}
+
 Ret Unit::run()
 {
     try {
@@ -139,15 +173,26 @@ Ret Unit::run()
                 p3.set(p1() * p2());
                 ip += 4;
             } else if (cmd == "30") {
-                if (io.empty()) {
+                if (!io.empty()) {
+                    p1.set(io.back());
+                    io.pop_back();
+                } else if (ascii_pos < ascii_in.size()) {
+                    p1.set(ascii_in[ascii_pos++]);
+                } else {
                     return Ret::INPUT;
                 }
-                p1.set(io.back());
-                io.pop_back();
                 ip += 2;
             } else if (cmd == "40") {
-                io.push_front(p1());
+                const auto v = p1();
                 ip += 2;
+                if (ascii && v >= 0 && v < 128) {
+                    ascii_out.push_back(v);
+                    if (ascii_limit && ascii_out.size() > ascii_limit) {
+                        return Ret::OUTPUT;
+                    }
+                    continue;
+                }
+                io.push_front(v);
                 return Ret::OUTPUT;
             } else if (cmd == "50") {  // jump-if-true
                 if (p1()) {
@@ -339,38 +384,34 @@ void dump2(Mapa const& mapa)
 }
 
 
-void run1(Unit unit)
+Mapa read_map(std::string_view screen)
 {
     Mapa mapa;
-    Point me {0, 0}, start {0, 0};
-
-    for(;;) {
-        auto res = unit.run();
-        if (res == Ret::OUTPUT) {
-            assert(unit.io.size() == 1);
-            switch ((char)unit.io.front()) {
-            case '.':
-                ++me.x;
-                break;
-            case '\xa':
-                ++me.y;
-                me.x = 0;
-                break;
-            case '#':
-                mapa.insert({me, (char)unit.io.front()});
-                ++me.x;
-                break;
-            case '^':
-                mapa.insert({me, (char)unit.io.front()});
-                start = me;
-                ++me.x;
-                break;
-            }
-            unit.io.clear();
-        } else {
+    Point me {0, 0};
+
+    for (const char c : screen) {
+        switch (c) {
+        case '.':
+            ++me.x;
+            break;
+        case '\xa':
+            ++me.y;
+            me.x = 0;
+            break;
+        case '#':
+        case '^':
+            mapa.insert({me, c});
+            ++me.x;
             break;
         }
-    };
+    }
+    return mapa;
+}
+
+
+void run1(Unit unit)
+{
+    Mapa mapa = read_map(unit.read_until_prompt());
 
     dump(mapa);
 
@@ -420,62 +461,17 @@ void run2(Unit unit)
     assert(unit.program.at(0) == 1);
     unit.program.at(0) = 2;
 
-    Mapa mapa;
-    Point me {0, 0}, start {0, 0};
-
-    Ret res;
-
-    for(;;) {
-        res = unit.run();
-        if (res == Ret::OUTPUT) {
-            assert(unit.io.size() == 1);
-            switch ((char)unit.io.front()) {
-            case '.':
-                ++me.x;
-                break;
-            case '\xa':
-                ++me.y;
-                me.x = 0;
-                break;
-            case '#':
-                mapa.insert({me, (char)unit.io.front()});
-                ++me.x;
-                break;
-            case '^':
-                mapa.insert({me, (char)unit.io.front()});
-                start = me;
-                ++me.x;
-                break;
-            }
-            unit.io.clear();
-        } else {
-            break;
-        }
-    };
-
-    const std::string feed = {"B,A,B,C,B,A,B,C,A,C\xa"
-                              "L,8,R,10,R,10,R,6\xa"
-                              "R,4,L,12,L,8,R,4\xa"
-                              "R,4,R,10,L,12\xa"
-                              "n\xa"};
-
-    int64_t last;
+    unit.read_until_prompt(); // the map and the "Main:" prompt
+    assert(unit.state == Ret::INPUT);
 
-    for (auto const& c : feed) {
-        assert(res == Ret::INPUT);
-        unit.io.push_front(c);
-        res = unit.run();
-        if (res == Ret::INPUT) {
-            continue;
-        }
-        while (res == Ret::OUTPUT) {
-            last = unit.io.front();
-            unit.io.clear();
-            res = unit.run();
-        }
+    for (auto const& line : {"B,A,B,C,B,A,B,C,A,C", "L,8,R,10,R,10,R,6", "R,4,L,12,L,8,R,4", "R,4,R,10,L,12", "n"}) {
+        unit.feed(line);
     }
 
-    std::cout << "2: " << last << "\n";
+    unit.read_until_prompt();
+    assert(unit.state == Ret::OUTPUT);
+
+    std::cout << "2: " << unit.io.front() << "\n";
 }
 
 int main(int argc, char* argv[])
@@ -1,19 +1,22 @@
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <boost/config.hpp>
 #include <boost/container_hash/hash.hpp>
-#include <boost/graph/adjacency_list.hpp>
-#include <boost/graph/compressed_sparse_row_graph.hpp>
-#include <boost/graph/detail/adjacency_list.hpp>
-#include <boost/graph/dijkstra_shortest_paths.hpp>
 
-#include <boost/graph/properties.hpp>
 #include <cassert>
 #include <cctype>
+#include <cstdint>
 #include <deque>
 #include <iostream>
 #include <limits>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <queue>
 #include <regex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 
 // #define DUMP
@@ -41,9 +44,6 @@ struct Player {
 
 struct Mapa
 {
-    using KeyDistanceMap = std::map<char, unsigned>;
-    using PlayerKeyDistanceMap = std::map<unsigned, KeyDistanceMap>;
-
     void append(std::string const& line)
     {
         max_x = line.size();
@@ -70,7 +70,6 @@ struct Mapa
             std::cout << line << "\n";
             line.clear();
         }
-        std::cout << std::hex << "keys: 0x" << owned_keys << std::dec << "\n";
         for (auto const& [ppos, player] : players) {
             std::cout << "P" << ppos << ": {" << player.x << ", " << player.y << "}\n";
         }
@@ -85,68 +84,6 @@ struct Mapa
         return data;
     }
 
-    PlayerKeyDistanceMap calculate_distances() const
-    {
-        using EdgeWeightProp = boost::property<boost::edge_weight_t, unsigned>;
-        using Graph = boost::adjacency_list<
-            boost::vecS, boost::vecS, boost::bidirectionalS, boost::property<boost::vertex_distance_t, unsigned>,
-            EdgeWeightProp>;
-        using Vertex = boost::graph_traits<Graph>::vertex_descriptor;
-
-        Graph g(data.size());
-
-        auto add_edge = [&](Vertex from, CoordType x, CoordType y) {
-            const auto c = get(x, y);
-            if (c == '#' || (c >= 'A' && c <= 'Z')) {
-                return;
-            };
-            boost::add_edge(from, xy_to_index(x, y), EdgeWeightProp{1}, g);
-        };
-
-        for (size_t idx = 0; idx < data.size(); ++idx) {
-            if (data.at(idx) == '#') {
-                // wall
-                continue;
-            }
-            auto const& [x, y] = index_to_xy(idx);
-            auto from = boost::vertex(idx, g);
-
-            if (has(x - 1, y)) { add_edge(from, x - 1, y); }
-            if (has(x + 1, y)) { add_edge(from, x + 1, y); }
-
-            if (has(x, y - 1)) { add_edge(from, x, y - 1); }
-            if (has(x, y + 1)) { add_edge(from, x, y + 1); }
-        }
-
-        PlayerKeyDistanceMap pkd;
-
-        for (auto const& [ppos, p] : players) {
-            CoordType origin = xy_to_index(p.x, p.y);
-            assert(origin != data.npos);
-
-            auto& kd = pkd[ppos];
-
-            boost::dijkstra_shortest_paths(
-                g, boost::vertex(origin, g), boost::distance_map(boost::get(boost::vertex_distance, g)));
-
-            auto const& dist = boost::get(boost::vertex_distance, g);
-            for (size_t idx = 0; idx < data.size(); ++idx) {
-                auto const& c = data.at(idx);
-                if (c >= 'a' && c <= 'z') {
-                    auto d = dist[boost::vertex(idx, g)];
-                    if (d < std::numeric_limits<int>::max()) {
-#ifdef DUMP
-                        std::cout << "P: " << ppos << ", dist to " << c << " is " << d << std::endl;
-#endif
-                        kd[c] = d;
-                    }
-                }
-            }
-        }
-
-        return pkd;
-    }
-
     bool has(CoordType x, CoordType y) const noexcept
     {
         return (x >= 0 && y >= 0 && x < max_x && y < max_y);
@@ -176,162 +113,547 @@ struct Mapa
 
     std::pair<CoordType, CoordType> get_max() const noexcept { return {max_x, max_y}; }
 
-    void move_player(unsigned ppos, char key)
+    unsigned player_count() const noexcept
     {
-        CoordType keyPos = data.find(key);
-        assert(keyPos != data.npos);
+        return players.size();
+    }
 
-        open_door(key);
+protected:
+    std::map<unsigned, Player> players;
+    CoordType max_x = 0, max_y = 0;
+    std::string data {};
+};
 
-        Player& player = players.at(ppos);
+// Search state packed into 64 bits: the owned keys in the low 26 bits and
+// above them 5 bits per robot with the node it stands on. Nodes 0-25 are the
+// keys, the robots start on the nodes from START up.
+namespace packed {
 
-        data[xy_to_index(player.x, player.y)] = '.';
-        data[keyPos] = '@';
+constexpr unsigned KEY_BITS = 26;
+constexpr unsigned NODE_BITS = 5;
+constexpr unsigned START = 26;
+constexpr unsigned MAX_ROBOTS = (1U << NODE_BITS) - START;
+constexpr uint64_t KEY_MASK = (1ULL << KEY_BITS) - 1;
 
-        std::tie(player.x, player.y) = index_to_xy(keyPos);
-    }
+constexpr uint64_t keys(uint64_t state) noexcept
+{
+    return state & KEY_MASK;
+}
 
-    friend size_t hash_value(Mapa const& mapa) noexcept {
-        size_t seed = 0;
-        for (auto const& [ppos, p] : mapa.players) {
-            boost::hash_combine(seed, ppos);
-            boost::hash_combine(seed, p);
+constexpr unsigned node(uint64_t state, unsigned robot) noexcept
+{
+    return (state >> (KEY_BITS + NODE_BITS * robot)) & ((1U << NODE_BITS) - 1);
+}
+
+// the robot walks to key node `key` and picks it up
+constexpr uint64_t move(uint64_t state, unsigned robot, unsigned key) noexcept
+{
+    const unsigned shift = KEY_BITS + NODE_BITS * robot;
+    state &= ~(((1ULL << NODE_BITS) - 1) << shift);
+    return state | (uint64_t {key} << shift) | (1ULL << key);
+}
+
+}  // namespace packed
+
+// Packed states with their distances in fixed-size slabs. Entries never
+// move, so the search refers to them by index, and all of it goes away at
+// once with the arena.
+struct StateArena
+{
+    static constexpr size_t SLAB = 1 << 16;
+
+    struct Entry
+    {
+        uint64_t state;
+        unsigned dist;
+    };
+
+    uint32_t push(uint64_t state, unsigned dist)
+    {
+        if (count % SLAB == 0) {
+            slabs.push_back(std::make_unique_for_overwrite<Entry[]>(SLAB));
         }
-        boost::hash_combine(seed, mapa.owned_keys);
-        return seed;
+        slabs.back()[count % SLAB] = {state, dist};
+        return count++;
+    }
+
+    Entry& operator[](uint32_t idx) noexcept
+    {
+        return slabs[idx / SLAB][idx % SLAB];
+    }
+
+    Entry const& operator[](uint32_t idx) const noexcept
+    {
+        return slabs[idx / SLAB][idx % SLAB];
+    }
+
+    size_t size() const noexcept
+    {
+        return count;
     }
 
-    bool operator==(Mapa const& o) const noexcept
+    size_t bytes() const noexcept
     {
-        assert(max_x == o.max_x);
-        assert(max_y == o.max_y);
-        return owned_keys == o.owned_keys && players == o.players;
+        return slabs.size() * SLAB * sizeof(Entry);
     }
 
 protected:
+    std::vector<std::unique_ptr<Entry[]>> slabs;
+    uint32_t count = 0;
+};
+
+// Best known distance of each packed state. The states live in the arena,
+// the open addressing table (linear probing) only holds their indices.
+struct DistanceTable
+{
+    static constexpr unsigned INF = std::numeric_limits<unsigned>::max();
+
+    // true if `dist` is better than the known distance, `idx` is the state's entry
+    bool update(uint64_t state, unsigned dist, uint32_t& idx)
+    {
+        if (2 * (arena.size() + 1) > slots.size()) {
+            grow();
+        }
+        uint32_t& slot = slots[find(state)];
+        if (slot == EMPTY) {
+            slot = arena.push(state, dist);
+        } else if (arena[slot].dist <= dist) {
+            return false;
+        } else {
+            arena[slot].dist = dist;
+        }
+        idx = slot;
+        return true;
+    }
+
+    unsigned get(uint64_t state) const noexcept
+    {
+        const uint32_t slot = slots[find(state)];
+        return slot == EMPTY ? INF : arena[slot].dist;
+    }
+
+    StateArena::Entry const& operator[](uint32_t idx) const noexcept
+    {
+        return arena[idx];
+    }
+
+    size_t size() const noexcept
+    {
+        return arena.size();
+    }
+
+    size_t bytes() const noexcept
+    {
+        return arena.bytes() + slots.size() * sizeof(uint32_t);
+    }
+
+    // the search reports its queue, to get the peak memory of the whole search
+    void queue_size(size_t bytes) noexcept
+    {
+        queue_peak = std::max(queue_peak, bytes);
+    }
 
-    void open_door(char k)
+    size_t peak_bytes() const noexcept
     {
-        assert(k >= 'a');
-        assert(k <= 'z');
+        return bytes() + queue_peak;
+    }
 
-        unsigned k_idx = 1 << (k - 'a');
-        assert((owned_keys & k_idx) == 0);
-        owned_keys |= k_idx;
+protected:
+    static constexpr uint32_t EMPTY = ~0U;
 
-        CoordType door = data.find(std::toupper(k));
-        if (door == data.npos) {
-            return;
+    size_t find(uint64_t state) const noexcept
+    {
+        const size_t mask = slots.size() - 1;
+        uint64_t h = state * 0x9E3779B97F4A7C15ULL;
+        size_t idx = (h ^ (h >> 32)) & mask;
+        while (slots[idx] != EMPTY && arena[slots[idx]].state != state) {
+            idx = (idx + 1) & mask;
         }
-        assert(door < data.size());
-        data[door] = '.';
+        return idx;
     }
 
-    std::map<unsigned, Player> players;
-    CoordType max_x = 0, max_y = 0;
-    std::string data {};
-    unsigned owned_keys = 0;
-};
+    void grow()
+    {
+        slots.assign(2 * slots.size(), EMPTY);
+        for (uint32_t i = 0; i < arena.size(); ++i) {
+            slots[find(arena[i].state)] = i;
+        }
+    }
 
-namespace std {
+    StateArena arena;
+    std::vector<uint32_t> slots = std::vector<uint32_t>(1 << 12, EMPTY);
+    size_t queue_peak = 0;
+};
 
-template <>
-struct hash<Mapa>
+// Open cells of a grid as bitboards, one bit per cell and every row padded to
+// whole 64bit words. The BFS expands the whole frontier at once with shifts
+// and masks, so a single-source search costs a few word operations per row
+// and layer. Cells are indexed as y * width + x.
+struct BitGrid
 {
-    size_t operator()(Mapa const& mapa) const noexcept
+    BitGrid(unsigned _width, unsigned _height)
+        : width {_width}
+        , height {_height}
+        , words {(_width + 63) / 64}
+        , open(words * _height, 0)
+    { }
+
+    void set_open(size_t idx) noexcept
     {
-        return hash_value(mapa);
+        open[bit_word(idx)] |= bit_mask(idx);
     }
-};
 
-}  // namespace std
+    // Calls visit(cell, distance) for every reachable cell, layer by layer.
+    template<typename Visit>
+    void bfs(size_t from, Visit&& visit) const
+    {
+        std::vector<uint64_t> visited(open.size(), 0), frontier(open.size(), 0), next(open.size(), 0);
+        frontier[bit_word(from)] = visited[bit_word(from)] = bit_mask(from);
+        visit(from, 0U);
+
+        for (unsigned d = 1;; ++d) {
+            bool any = false;
+            for (size_t y = 0; y < height; ++y) {
+                const uint64_t* row = &frontier[y * words];
+                for (size_t w = 0; w < words; ++w) {
+                    uint64_t n = (row[w] << 1) | (row[w] >> 1);
+                    if (w > 0) {
+                        n |= row[w - 1] >> 63;
+                    }
+                    if (w + 1 < words) {
+                        n |= row[w + 1] << 63;
+                    }
+                    if (y > 0) {
+                        n |= row[w - words];
+                    }
+                    if (y + 1 < height) {
+                        n |= row[w + words];
+                    }
+                    const size_t i = y * words + w;
+                    next[i] = n & open[i] & ~visited[i];
+                    any |= next[i] != 0;
+                }
+            }
+            if (!any) {
+                break;
+            }
 
-using EdgeWeightProp = boost::property<boost::edge_weight_t, unsigned>;
-using Graph = boost::adjacency_list<
-    boost::vecS,
-    boost::vecS,
-    boost::directedS,
-    boost::property<boost::vertex_distance_t, unsigned>,
-    EdgeWeightProp>;
-using Vertex = boost::graph_traits<Graph>::vertex_descriptor;
+            for (size_t i = 0; i < next.size(); ++i) {
+                visited[i] |= next[i];
+                for (uint64_t bits = next[i]; bits; bits &= bits - 1) {
+                    visit((i / words) * width + (i % words) * 64 + std::countr_zero(bits), d);
+                }
+            }
+            std::swap(frontier, next);
+        }
+    }
 
-using VertexMap = std::map<std::string, Vertex>;
+protected:
+    size_t bit_word(size_t idx) const noexcept
+    {
+        return (idx / width) * words + (idx % width) / 64;
+    }
+
+    uint64_t bit_mask(size_t idx) const noexcept
+    {
+        return 1ULL << ((idx % width) % 64);
+    }
 
-template<typename>
-class TD;
+    const size_t width, height, words;
+    std::vector<uint64_t> open;
+};
 
-int part1(Mapa mapa)
+// Shortest walk between two nodes with the doors and keys on the way.
+struct Route
 {
-    Graph g;
+    unsigned dist = DistanceTable::INF;
+    uint32_t doors = 0;
+    uint32_t keys = 0; // without the target key itself
+};
+
+// Dijkstra over the packed states, generated on the fly. It stops as soon as
+// a state with all the keys is taken from the queue. The routes between all
+// the nodes are found once up front, so an expansion is just a table lookup.
+struct KeySearch
+{
+    explicit KeySearch(Mapa const& _mapa)
+        : mapa {_mapa}
+        , robots {_mapa.player_count()}
+        , nodes(packed::START + robots, -1)
+        , routes(nodes.size() * packed::KEY_BITS)
+    {
+        assert(robots <= packed::MAX_ROBOTS);
+        const auto data = mapa.get_data();
+        for (size_t idx = 0; idx < data.size(); ++idx) {
+            const char c = data[idx];
+            if (c >= 'a' && c <= 'z') {
+                nodes[c - 'a'] = idx;
+                all_keys |= 1ULL << (c - 'a');
+            }
+        }
+        for (unsigned r = 0; r < robots; ++r) {
+            auto const& p = mapa.get_player(r);
+            nodes[packed::START + r] = mapa.xy_to_index(p.x, p.y);
+        }
 
-    std::unordered_map<Mapa, Vertex> states;
-    std::deque<Mapa> states_queue;
+        auto const& [max_x, max_y] = mapa.get_max();
+        BitGrid grid(max_x, max_y);
+        for (size_t idx = 0; idx < data.size(); ++idx) {
+            if (data[idx] != '#') {
+                grid.set_open(idx);
+            }
+        }
 
-    Vertex start_v = boost::add_vertex(g);
-    states.insert({mapa, start_v});
-    states_queue.push_back(mapa);
+        for (unsigned n = 0; n < nodes.size(); ++n) {
+            if (nodes[n] >= 0) {
+                find_routes(n, grid, data);
+            }
+        }
+    }
 
-    Vertex dst = boost::add_vertex(g);
+    uint64_t start() const noexcept
+    {
+        uint64_t state = 0;
+        for (unsigned r = 0; r < robots; ++r) {
+            state |= uint64_t {packed::START + r} << (packed::KEY_BITS + packed::NODE_BITS * r);
+        }
+        return state;
+    }
 
-    while(!states_queue.empty()) {
-        const Mapa m = states_queue.front();
-        states_queue.pop_front();
+    unsigned robot_count() const noexcept
+    {
+        return robots;
+    }
 
-        const Vertex from = states.at(m);
+    uint64_t keys() const noexcept
+    {
+        return all_keys;
+    }
 
-#ifdef DUMP
-        std::cout << "\n";
-        m.dump();
-#endif
+    // keys the robot could ever walk to, doors aside
+    uint64_t reachable(unsigned robot) const noexcept
+    {
+        uint64_t keys = 0;
+        for (uint64_t todo = all_keys; todo; todo &= todo - 1) {
+            const unsigned key = std::countr_zero(todo);
+            if (route(packed::START + robot, key).dist != DistanceTable::INF) {
+                keys |= 1ULL << key;
+            }
+        }
+        return keys;
+    }
 
-        auto next_moves = m.calculate_distances();
+    Route const& route(unsigned from, unsigned key) const noexcept
+    {
+        return routes[from * packed::KEY_BITS + key];
+    }
 
-        unsigned empty_moves = 0;
-        for (auto const& [ppos, moves] : next_moves) {
-#ifdef DUMP
-            std::cout << "moves: " << moves.size() << std::endl;
-#endif
-            if (moves.empty()) {
-                // end
-                ++empty_moves;
+    // Dijkstra from `from` moving only the robots in the `moving` bit mask,
+    // until all the keys are owned. `end` is set to the final state.
+    unsigned run(uint64_t from, unsigned moving, DistanceTable& best, uint64_t& end) const
+    {
+        // distance and the arena index of the state
+        using Item = std::pair<unsigned, uint32_t>;
+        std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+
+        uint32_t idx = 0;
+        best.update(from, 0, idx);
+        queue.push({0, idx});
+
+        while (!queue.empty()) {
+            best.queue_size(queue.size() * sizeof(Item));
+            auto const [d, top] = queue.top();
+            queue.pop();
+
+            auto const [state, known] = best[top];
+            if (known < d) {
                 continue;
             }
+            const uint64_t keys = packed::keys(state);
+            if (keys == all_keys) {
+                end = state;
+                return d;
+            }
 
-            for (auto const& [key, dist] : moves) {
-                Mapa m2 = m;
-                m2.move_player(ppos, key);
-                auto it = states.find(m2);
-                if (it == states.end()) {
-                    Vertex to = boost::add_vertex(g);
-                    auto const& [_, in] = boost::add_edge(from, to, EdgeWeightProp {dist}, g);
-                    assert(in);
-                    states.insert({m2, to});
-                    states_queue.push_back(std::move(m2));
-                } else {
-#ifdef DUMP
-                    std::cout << "state already seen; new dist " << dist << "\n";
-#endif
-                    auto const& [_, in] = boost::add_edge(from, it->second, EdgeWeightProp {dist}, g);
-                    assert(in);
+            for (unsigned r = 0; r < robots; ++r) {
+                if (!(moving & (1U << r))) {
+                    continue;
+                }
+                const Route* routes_from = &route(packed::node(state, r), 0);
+                for (uint64_t todo = all_keys & ~keys; todo; todo &= todo - 1) {
+                    const unsigned key = std::countr_zero(todo);
+                    auto const& rt = routes_from[key];
+                    // closed door, or another key would be picked up on the way
+                    if (rt.dist == DistanceTable::INF || ((rt.doors | rt.keys) & ~keys)) {
+                        continue;
+                    }
+                    const auto next = packed::move(state, r, key);
+                    if (best.update(next, d + rt.dist, idx)) {
+                        queue.push({d + rt.dist, idx});
+                    }
                 }
             }
         }
 
-        if (empty_moves == next_moves.size()) {
-#ifdef DUMP
-            std::cout << "FINISHED" << std::endl;
-#endif
-            boost::add_edge(from, dst, EdgeWeightProp {0}, g);
+        return DistanceTable::INF;
+    }
+
+    // Keys picked up by the robot on the way to `end`, in order. Walks back
+    // through the states whose distance plus the route matches.
+    std::vector<unsigned> path(DistanceTable const& best, uint64_t end, unsigned robot) const
+    {
+        std::vector<unsigned> keys;
+        const unsigned shift = packed::KEY_BITS + packed::NODE_BITS * robot;
+        const uint64_t node_mask = ((1ULL << packed::NODE_BITS) - 1) << shift;
+
+        for (uint64_t state = end; packed::node(state, robot) < packed::START;) {
+            const unsigned key = packed::node(state, robot);
+            const uint64_t before = packed::keys(state) & ~(1ULL << key);
+            const unsigned dist = best.get(state);
+
+            bool found = false;
+            for (unsigned prev = 0; prev < nodes.size() && !found; ++prev) {
+                if (prev < packed::START ? !(before & (1ULL << prev)) : prev != packed::START + robot) {
+                    continue;
+                }
+                auto const& rt = route(prev, key);
+                const uint64_t p = (state & ~node_mask & ~(1ULL << key)) | (uint64_t {prev} << shift);
+                if (rt.dist != DistanceTable::INF && !((rt.doors | rt.keys) & ~before)
+                    && best.get(p) != DistanceTable::INF && best.get(p) + rt.dist == dist) {
+                    keys.push_back(key);
+                    state = p;
+                    found = true;
+                }
+            }
+            assert(found);
         }
+
+        std::reverse(keys.begin(), keys.end());
+        return keys;
     }
 
-    std::cout << "States: " << states.size() << std::endl;
+protected:
+    // BFS over the whole grid from the node, doors are passable but noted.
+    // The cells come layer by layer, so a neighbour one step closer is already done.
+    void find_routes(unsigned node, BitGrid const& grid, std::string const& data)
+    {
+        auto const& [max_x, _] = mapa.get_max();
 
-    auto dist_map = boost::get(boost::vertex_distance, g);
+        std::vector<Route> cells(data.size());
 
-    boost::dijkstra_shortest_paths(g, start_v, boost::distance_map(dist_map));
+        grid.bfs(nodes[node], [&](size_t idx, unsigned d) {
+            Route& r = cells[idx];
+            if (d == 0) {
+                r.dist = 0;
+                return;
+            }
+
+            for (auto prev : {idx - 1, idx + 1, idx - max_x, idx + max_x}) {
+                if (prev < data.size() && cells[prev].dist + 1 == d) {
+                    r = cells[prev];
+                    break;
+                }
+            }
+            r.dist = d;
+
+            const char c = data[idx];
+            if (c >= 'A' && c <= 'Z') {
+                r.doors |= 1U << (c - 'A');
+            } else if (c >= 'a' && c <= 'z') {
+                routes[node * packed::KEY_BITS + (c - 'a')] = r;
+                r.keys |= 1U << (c - 'a');
+            }
+        });
+    }
+
+    Mapa const& mapa;
+    const unsigned robots;
+    std::vector<CoordType> nodes;   // node -> grid index
+    std::vector<Route> routes;      // [from node][to key]
+    uint64_t all_keys = 0;
+};
+
+unsigned part1(Mapa const& mapa)
+{
+    KeySearch search {mapa};
+    DistanceTable best;
+    uint64_t end = 0;
+    auto result = search.run(search.start(), (1U << search.robot_count()) - 1, best, end);
+    std::cout << "States: " << best.size() << ", peak memory: " << best.peak_bytes() / 1024 << " KiB" << std::endl;
+    return result;
+}
+
+// Every robot alone, with the doors of keys from the other quadrants taken
+// as open, in parallel. The sum is a lower bound of the joint search; it is
+// the answer when the pickups can be interleaved so that every such door is
+// opened in time. Otherwise the joint search over all robots decides.
+unsigned solve_quadrants(Mapa const& mapa)
+{
+    KeySearch search {mapa};
+    const unsigned robots = search.robot_count();
+
+    std::vector<uint64_t> own(robots);
+    uint64_t seen = 0;
+    bool disjoint = true;
+    for (unsigned r = 0; r < robots; ++r) {
+        own[r] = search.reachable(r);
+        disjoint &= !(seen & own[r]);
+        seen |= own[r];
+    }
+    if (!disjoint || seen != search.keys()) {
+        return part1(mapa);
+    }
+
+    std::vector<unsigned> dist(robots);
+    std::vector<std::vector<unsigned>> paths(robots);
+    std::vector<size_t> states(robots), memory(robots);
+    {
+        std::vector<std::thread> pool;
+        for (unsigned r = 0; r < robots; ++r) {
+            pool.emplace_back([&, r]() {
+                DistanceTable best;
+                uint64_t end = 0;
+                dist[r] = search.run(search.start() | (search.keys() & ~own[r]), 1U << r, best, end);
+                if (dist[r] != DistanceTable::INF) {
+                    paths[r] = search.path(best, end, r);
+                }
+                states[r] = best.size();
+                memory[r] = best.peak_bytes();
+            });
+        }
+        for (auto& th : pool) {
+            th.join();
+        }
+    }
+
+    std::cout << "States: " << std::accumulate(states.begin(), states.end(), size_t {0})
+              << ", peak memory: " << std::accumulate(memory.begin(), memory.end(), size_t {0}) / 1024 << " KiB"
+              << std::endl;
+
+    // interleave the pickups, a robot waits while a foreign door is closed
+    uint64_t owned = 0;
+    std::vector<size_t> done(robots, 0);
+    for (bool progress = true; progress;) {
+        progress = false;
+        for (unsigned r = 0; r < robots; ++r) {
+            for (; done[r] < paths[r].size(); ++done[r]) {
+                const unsigned from = done[r] ? paths[r][done[r] - 1] : packed::START + r;
+                const unsigned key = paths[r][done[r]];
+                if (search.route(from, key).doors & ~own[r] & ~owned) {
+                    break;
+                }
+                owned |= 1ULL << key;
+                progress = true;
+            }
+        }
+    }
+
+    if (owned != search.keys()) {
+        std::cout << "Quadrants depend on each other, joint search" << std::endl;
+        return part1(mapa);
+    }
 
-    return dist_map[dst];
+    return std::accumulate(dist.begin(), dist.end(), 0U);
 }
 
 unsigned part2(Mapa const& m1)
@@ -364,7 +686,7 @@ unsigned part2(Mapa const& m1)
     // m1.dump();
     // m2.dump();
 
-    return part1(m2);
+    return solve_quadrants(m2);
 }
 
 
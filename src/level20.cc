@@ -1,514 +1,460 @@
-#include <boost/config.hpp>
-#include <boost/container_hash/hash.hpp>
-#include <boost/graph/adjacency_list.hpp>
-#include <boost/graph/compressed_sparse_row_graph.hpp>
-#include <boost/graph/detail/adjacency_list.hpp>
-#include <boost/graph/dijkstra_shortest_paths.hpp>
-
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <cassert>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
-#include <optional>
+#include <limits>
+#include <queue>
 #include <string>
-#include <unordered_map>
-
-using EdgeWeightProp = boost::property<boost::edge_weight_t, unsigned>;
-using Graph = boost::adjacency_list<
-    boost::vecS,
-    boost::vecS,
-    boost::bidirectionalS,
-    boost::property<boost::vertex_distance_t, unsigned>,
-    EdgeWeightProp>;
-using Vertex = boost::graph_traits<Graph>::vertex_descriptor;
-
-
-struct Direction
-{
-    using value_t = int;
-
-    Direction()
-        : Direction(NONE)
-    { }
-
-    Direction(value_t _dx, value_t _dy, value_t _dz) noexcept : dx{_dx}, dy{_dy}, dz{_dz} {}
-
-    value_t get_dx() const noexcept { return dx; }
-    value_t get_dy() const noexcept { return dy; }
-    value_t get_dz() const noexcept { return dz; }
-
-    bool operator==(const Direction& o) const noexcept { return dx == o.dx && dy == o.dy && dz == o.dz; }
-
-    static Direction oposite(Direction const& d) noexcept
-    {
-        if (d == Direction::NORTH) return Direction::SOUTH;
-        if (d == Direction::SOUTH) return Direction::NORTH;
-        if (d == Direction::EAST) return Direction::WEST;
-        if (d == Direction::WEST) return Direction::EAST;
-        if (d == Direction::UP) return Direction::DOWN;
-        if (d == Direction::DOWN) return Direction::UP;
-
-        assert(false);
-    }
-
-    static const Direction NONE, NORTH, SOUTH, EAST, WEST, UP, DOWN;
-protected:
-    value_t dx = 0, dy = 0, dz = 0;
-};
-
-const Direction Direction::NONE {0, 0, 0};
-const Direction Direction::NORTH {0, -1, 0};
-const Direction Direction::SOUTH {0, +1, 0};
-const Direction Direction::EAST {+1, 0, 0};
-const Direction Direction::WEST {-1, 0, 0};
-const Direction Direction::UP {0, 0, 1};
-const Direction Direction::DOWN {0, 0, -1};
-
-
-struct Point
-{
-    using value_t = int64_t;
+#include <string_view>
+#include <tuple>
+#include <vector>
 
-    value_t x = -1, y = -1, z = -1;
 
-    Point() = default;
+// Two letter portal name as a number, AA is 0 and ZZ is 26 * 26 - 1.
+using PortalId = uint16_t;
 
-    constexpr Point(value_t x_, value_t y_, value_t z_) noexcept
-        : x {x_}
-        , y {y_}
-        , z {z_}
-    { }
-
-    bool operator==(Point const& o) const noexcept
-    {
-        return x == o.x && y == o.y && z == o.z;
-    }
-
-    bool empty() const noexcept { return x == -1 && y == -1 && z == -1; }
+constexpr PortalId PORTAL_IDS = 26 * 26;
+constexpr PortalId AA = 0;
+constexpr PortalId ZZ = PORTAL_IDS - 1;
 
-    operator bool() const noexcept { return !empty(); }
-};
-
-Point operator+(Point const& p, Direction const& d) noexcept
+constexpr PortalId portal_id(char a, char b) noexcept
 {
-    return {p.x + d.get_dx(), p.y + d.get_dy(), p.z + d.get_dz()};
+    return (a - 'A') * 26 + (b - 'A');
 }
 
-
-struct Tile
+// The maze as read, row-major one byte per cell with every line padded to
+// the same width, plus a side table of the portal cells. Labels take two
+// cells around the maze, so the open cells never touch the border.
+struct Maze
 {
-    unsigned char val {};
-    std::optional<Point> dest {};
-    std::optional<std::string> dest_name {};
-    Direction up_down {};
-    Vertex vertex {};
-};
-
+    static constexpr size_t NONE = std::numeric_limits<size_t>::max();
 
-using Mapa = std::unordered_map<Point, Tile>;
-
-using Teleport = std::pair<Point, Point>;
-using Teleports = std::unordered_map<std::string, Teleport>;
+    struct Portal
+    {
+        PortalId id;
+        size_t cell;          // the '.' next to the label
+        size_t other = NONE;  // portal on the other side, NONE for AA and ZZ
+        bool outer = false;
+    };
 
-namespace std {
+    size_t width = 0, height = 0;
+    std::string data;
+    std::vector<Portal> portals;
 
-template<>
-struct hash<Point>
-{
-    size_t operator()(Point const& p) const noexcept
+    bool open(size_t cell) const noexcept
     {
-        size_t seed = 0;
-        boost::hash_combine(seed, p.x);
-        boost::hash_combine(seed, p.y);
-        boost::hash_combine(seed, p.z);
-        return seed;
+        return data[cell] == '.';
     }
 };
 
-std::ostream& operator<<(std::ostream& os, Point const& p)
-{
-    os << "(" << p.x << "; " << p.y << "; " << p.z << ")";
-    return os;
-}
 
-std::ostream& operator<<(std::ostream& os, Direction const& d)
+bool is_label(char c) noexcept
 {
-    if (d == Direction::NONE) {
-        os << "NONE";
-    } else if (d == Direction::WEST) {
-        os << "WEST";
-    } else if (d == Direction::EAST) {
-        os << "EAST";
-    } else if (d == Direction::NORTH) {
-        os << "NORTH";
-    } else if (d == Direction::SOUTH) {
-        os << "SOUTH";
-    } else if (d == Direction::UP) {
-        os << "UP";
-    } else if (d == Direction::DOWN) {
-        os << "DOWN";
-    } else {
-        assert(false);
-    }
-    return os;
+    return c >= 'A' && c <= 'Z';
 }
 
 
-}  // namespace std
-
-
-std::tuple<Point::value_t, Point::value_t, Point::value_t, Point::value_t, Point::value_t, Point::value_t> mapa_min_max(
-    Mapa const& mapa)
+Maze load_map()
 {
-    Point::value_t min_x = std::numeric_limits<Point::value_t>::max(),
-                   min_y = std::numeric_limits<Point::value_t>::max(),
-                   min_z = std::numeric_limits<Point::value_t>::max(),
-                   max_x = std::numeric_limits<Point::value_t>::min(),
-                   max_y = std::numeric_limits<Point::value_t>::min(),
-                   max_z = std::numeric_limits<Point::value_t>::min();
-    for (auto const& [px, _] : mapa) {
-        min_x = std::min(min_x, px.x);
-        min_y = std::min(min_y, px.y);
-        min_z = std::min(min_z, px.z);
-        max_x = std::max(max_x, px.x);
-        max_y = std::max(max_y, px.y);
-        max_z = std::max(max_z, px.z);
-    }
-    return std::tie(min_x, min_y, min_z, max_x, max_y, max_z);
-}
-
-
-void dump(Mapa const& mapa, Point::value_t z = 0)
-{
-    std::cout << "-------------------------------------------------------------------------------\n";
-    auto const& [min_x, min_y, min_z, max_x, max_y, max_z] = mapa_min_max(mapa);
-    for (Point::value_t y = min_y; y <= max_y; ++y) {
-        for (Point::value_t x = min_x; x <= max_x; ++x) {
-            auto it = mapa.find({x, y, z});
-            if (it == mapa.end()) {
-                std::cout << " ";
-                continue;
-            }
-            std::cout << it->second.val;
-        }
-        std::cout << "\n";
-    }
-    std::cout << "-------------------------------------------------------------------------------\n";
-}
-
-
-Mapa load_map()
-{
-    Mapa mapa;
-    Point p0 {0, 0, 0};
+    Maze maze;
+    std::vector<std::string> lines;
 
     std::string line;
     while (std::getline(std::cin, line)) {
         if (line.empty()) {
             break;
         }
-        for (auto c : line) {
-            if (c == ' ') {
-                ++p0.x;
-                continue;
-            }
-            mapa.insert({p0, {.val = static_cast<unsigned char>(c)}});
-            ++p0.x;
-        }
-        p0.x = 0;
-        ++p0.y;
+        maze.width = std::max(maze.width, line.size());
+        lines.push_back(std::move(line));
+    }
+    maze.height = lines.size();
+    maze.data.reserve(maze.width * maze.height);
+    for (auto& l : lines) {
+        l.resize(maze.width, ' ');
+        maze.data += l;
     }
-    return mapa;
-}
-
-
-void resolve_teleports(Mapa& mapa)
-{
-    Teleports teleports;
-
-    auto check_key = [&mapa](Point const& p1, Direction d) noexcept -> bool {
-        const Point p2 {p1 + d};
-        return (mapa.contains(p2) && (mapa.at(p2).val >= 'A' && mapa.at(p2).val <= 'Z'));
-    };
 
-    for (auto it = mapa.begin(); it != mapa.end();) {
-        auto const& [k, v] = *it;
+    // a label is read left to right or top to bottom; its first letter finds
+    // the open cell on either end of the pair
+    const size_t w = maze.width;
+    std::array<size_t, PORTAL_IDS> first;
+    first.fill(Maze::NONE);
 
-        if (!(v.val == '.')) {
-            ++it;
+    for (size_t c = 0; c < maze.data.size(); ++c) {
+        if (!is_label(maze.data[c])) {
             continue;
         }
-
-        const Point p1 = k;
-        Point p2;
-        Point p3;
-
-        assert(mapa.at(p1).val == '.');
-
-        if (check_key(k, Direction::NORTH)) {
-            p2 = p1 + Direction::NORTH;
-            p3 = p2 + Direction::NORTH;
-            std::swap(p2, p3);  // reading direction
-        } else if (check_key(k, Direction::SOUTH)) {
-            p2 = p1 + Direction::SOUTH;
-            p3 = p2 + Direction::SOUTH;
-        } else if (check_key(k, Direction::WEST)) {
-            p2 = p1 + Direction::WEST;
-            p3 = p2 + Direction::WEST;
-            std::swap(p2, p3);  // reading direction
-        } else if (check_key(k, Direction::EAST)) {
-            p2 = p1 + Direction::EAST;
-            p3 = p2 + Direction::EAST;
+        const size_t x = c % w, y = c / w;
+        size_t second, cell;
+        if (x + 1 < w && is_label(maze.data[c + 1])) {
+            second = c + 1;
+            cell = (x + 2 < w && maze.open(c + 2)) ? c + 2 : c - 1;
+        } else if (y + 1 < maze.height && is_label(maze.data[c + w])) {
+            second = c + w;
+            cell = (y + 2 < maze.height && maze.open(c + 2 * w)) ? c + 2 * w : c - w;
         } else {
-            ++it;
             continue;
         }
-
-        assert(mapa.contains(p2));
-        assert(mapa.contains(p3));
-
-        std::string tkey;
-        tkey += mapa.at(p2).val;
-        tkey += mapa.at(p3).val;
-
-        Teleport& t = teleports[tkey];
-        if (t.first) {
-            assert(!t.second);
-            t.second = p1;
+        assert(maze.open(cell));
+
+        const size_t sx = second % w, sy = second / w;
+        Maze::Portal p {
+            .id = portal_id(maze.data[c], maze.data[second]),
+            .cell = cell,
+            .outer = x < 2 || y < 2 || sx + 2 >= w || sy + 2 >= maze.height,
+        };
+
+        const size_t idx = maze.portals.size();
+        if (first[p.id] == Maze::NONE) {
+            first[p.id] = idx;
         } else {
-            t.first = p1;
+            p.other = first[p.id];
+            maze.portals[first[p.id]].other = idx;
         }
-
-        mapa.erase(p2);
-        mapa.erase(p3);
-        it = mapa.begin();
-
-        // std::cout << "Gate " << g << ", name " << tkey << std::endl;
-        // dump(mapa);
+        maze.portals.push_back(p);
     }
 
-
-    for (auto const& [tkey, gates] : teleports) {
-        if (!gates.second) {
-            // std::cout << "Teleport " << tkey << " has only one point " << gates.first << std::endl;
-            assert(mapa.contains(gates.first));
-            mapa.at(gates.first).dest = std::nullopt; // no destination
-            mapa.at(gates.first).dest_name = tkey;
-        } else {
-            assert(mapa.contains(gates.first));
-            assert(mapa.contains(gates.second));
-            mapa.at(gates.first).dest = gates.second;
-            mapa.at(gates.second).dest = gates.first;
-            mapa.at(gates.first).dest_name = tkey;
-            mapa.at(gates.second).dest_name = tkey;
-        }
-    }
+    return maze;
 }
 
 
-void resolve_outer(Mapa& mapa)
+void dump(Maze const& maze)
 {
-    auto const& [min_x, min_y, min_z, max_x, max_y, max_z] = mapa_min_max(mapa);
-
-    // add all verticies
-    for (Point::value_t z = min_z; z <= max_z; ++z) {
-        for (Point::value_t y = min_y; y <= max_y; ++y) {
-            for (Point::value_t x = min_x; x <= max_x; ++x) {
-                auto it = mapa.find({x, y, z});
-                if (it == mapa.end()) continue;
-                it->second.up_down =
-                    (x == min_x || x == max_x || y == min_y || y == max_y) ? Direction::UP : Direction::DOWN;
-            }
-        }
+    std::cout << "-------------------------------------------------------------------------------\n";
+    for (size_t y = 0; y < maze.height; ++y) {
+        std::cout << std::string_view(maze.data).substr(y * maze.width, maze.width) << "\n";
     }
+    std::cout << "-------------------------------------------------------------------------------\n";
 }
 
 
-
-Graph create_graph(Mapa& mapa)
+// Open cells of a grid as bitboards, one bit per cell and every row padded to
+// whole 64bit words. The BFS expands the whole frontier at once with shifts
+// and masks, so a single-source search costs a few word operations per row
+// and layer. Cells are indexed as y * width + x.
+struct BitGrid
 {
-    Graph g {};
+    BitGrid(unsigned _width, unsigned _height)
+        : width {_width}
+        , height {_height}
+        , words {(_width + 63) / 64}
+        , open(words * _height, 0)
+    { }
 
-    auto const& [min_x, min_y, min_z, max_x, max_y, max_z] = mapa_min_max(mapa);
+    void set_open(size_t idx) noexcept
+    {
+        open[bit_word(idx)] |= bit_mask(idx);
+    }
 
-    // add all verticies
-    for (Point::value_t z = min_z; z <= max_z; ++z) {
-        for (Point::value_t y = min_y; y <= max_y; ++y) {
-            for (Point::value_t x = min_x; x <= max_x; ++x) {
-                const Point px {x, y, z};
-                auto it = mapa.find(px);
-                if (it == mapa.end() || it->second.val != '.') continue;
+    // Calls visit(cell, distance) for every reachable cell, layer by layer.
+    template<typename Visit>
+    void bfs(size_t from, Visit&& visit) const
+    {
+        std::vector<uint64_t> visited(open.size(), 0), frontier(open.size(), 0), next(open.size(), 0);
+        frontier[bit_word(from)] = visited[bit_word(from)] = bit_mask(from);
+        visit(from, 0U);
+
+        for (unsigned d = 1;; ++d) {
+            bool any = false;
+            for (size_t y = 0; y < height; ++y) {
+                const uint64_t* row = &frontier[y * words];
+                for (size_t w = 0; w < words; ++w) {
+                    uint64_t n = (row[w] << 1) | (row[w] >> 1);
+                    if (w > 0) {
+                        n |= row[w - 1] >> 63;
+                    }
+                    if (w + 1 < words) {
+                        n |= row[w + 1] << 63;
+                    }
+                    if (y > 0) {
+                        n |= row[w - words];
+                    }
+                    if (y + 1 < height) {
+                        n |= row[w + words];
+                    }
+                    const size_t i = y * words + w;
+                    next[i] = n & open[i] & ~visited[i];
+                    any |= next[i] != 0;
+                }
+            }
+            if (!any) {
+                break;
+            }
 
-                Tile& t = it->second;
-                t.vertex = add_vertex(g);
+            for (size_t i = 0; i < next.size(); ++i) {
+                visited[i] |= next[i];
+                for (uint64_t bits = next[i]; bits; bits &= bits - 1) {
+                    visit((i / words) * width + (i % words) * 64 + std::countr_zero(bits), d);
+                }
             }
+            std::swap(frontier, next);
         }
     }
 
-    // connect verticies
-    auto link_nodes = [&mapa, &g](Point const& p1, const Direction d) {
-        assert(mapa.contains(p1));
-        assert(mapa.at(p1).val == '.');
-        const Point p2 {p1 + d};
-        if (mapa.contains(p2) && mapa.at(p2).val == '.') {
-            boost::add_edge(mapa.at(p1).vertex, mapa.at(p2).vertex, EdgeWeightProp {1}, g);
-            // std::cout << "Link " << p1 << " with " << p2 << std::endl;
-        }
-    };
+protected:
+    size_t bit_word(size_t idx) const noexcept
+    {
+        return (idx / width) * words + (idx % width) / 64;
+    }
 
-    for (Point::value_t z = min_z; z <= max_z; ++z) {
-        for (Point::value_t y = min_y; y <= max_y; ++y) {
-            for (Point::value_t x = min_x; x <= max_x; ++x) {
-                const Point px {x, y, z};
-                const auto it = mapa.find(px);
-                if (it == mapa.end() || it->second.val != '.') continue;
-
-                link_nodes(px, Direction::NORTH);
-                link_nodes(px, Direction::SOUTH);
-                link_nodes(px, Direction::WEST);
-                link_nodes(px, Direction::EAST);
-
-                if (it->second.dest) {
-                    const Point& p2 = it->second.dest.value();
-                    if (mapa.contains(p2)) {  // might go to level not yet added
-                        boost::add_edge(mapa.at(px).vertex, mapa.at(p2).vertex, EdgeWeightProp {1}, g);
-                        // std::cout << "Link " << px << " with " << p2 << " teleport"<< std::endl;
-                    }
-                }
-            }
-        }
+    uint64_t bit_mask(size_t idx) const noexcept
+    {
+        return 1ULL << ((idx % width) % 64);
     }
 
-    return g;
-}
+    const size_t width, height, words;
+    std::vector<uint64_t> open;
+};
+
 
 template<typename T>
 class TD;
 
-std::pair<Vertex, Vertex> find_start_end(Mapa const& mapa)
+// The maze contracted to its portal cells: walking distances between the
+// portals of the same level, and the portal pairs that jump between levels.
+struct PortalGraph
 {
-    Vertex from {}, to {};
-    bool has_from {}, has_to {};
-
-    for (auto const& [_, tile] : mapa) {
-        if (tile.dest_name) {
-            if (!has_from && tile.dest_name.value() == "AA") {
-                from = tile.vertex;
-                has_from = true;
-            } else if (!has_to && tile.dest_name.value() == "ZZ") {
-                to = tile.vertex;
-                has_to = true;
-            }
-        }
-        if (has_from && has_to) break;
-    }
+    static constexpr size_t NONE = Maze::NONE;
 
-    return {from, to};
-}
+    struct Node
+    {
+        PortalId id;
+        size_t cell;
+        size_t other = NONE;  // node on the other side of the portal
+        int dz = 0;           // -1 outer (goes up), +1 inner (goes down), 0 for AA and ZZ
+    };
 
+    struct Edge
+    {
+        size_t to;
+        unsigned dist;
+    };
 
-void part1(Mapa mapa)
-{
-    auto g = create_graph(mapa);
+    std::vector<Node> nodes;
+    std::vector<std::vector<Edge>> edges;
+    size_t from = NONE, to = NONE;
+};
 
-    const auto& [from, to] = find_start_end(mapa);
 
-    boost::dijkstra_shortest_paths(g, from, boost::distance_map(boost::get(boost::vertex_distance, g)));
+// BFS from every portal over the open cells, the rest of the grid is no
+// longer needed after this
+PortalGraph contract(Maze const& maze)
+{
+    BitGrid grid(maze.width, maze.height);
+    for (size_t c = 0; c < maze.data.size(); ++c) {
+        if (maze.open(c)) {
+            grid.set_open(c);
+        }
+    }
+
+    PortalGraph g;
+    std::vector<size_t> node_of(maze.data.size(), PortalGraph::NONE);  // cell to node
+
+    for (auto const& p : maze.portals) {
+        node_of[p.cell] = g.nodes.size();
+        g.nodes.push_back({
+            .id = p.id,
+            .cell = p.cell,
+            .other = p.other,
+            .dz = p.other == Maze::NONE ? 0 : (p.outer ? -1 : +1),
+        });
+        if (p.id == AA) {
+            g.from = g.nodes.size() - 1;
+        } else if (p.id == ZZ) {
+            g.to = g.nodes.size() - 1;
+        }
+    }
 
-    auto const& dist = boost::get(boost::vertex_distance, g);
+    g.edges.resize(g.nodes.size());
+    for (size_t n = 0; n < g.nodes.size(); ++n) {
+        grid.bfs(g.nodes[n].cell, [&](size_t idx, unsigned d) {
+            if (d > 0 && node_of[idx] != PortalGraph::NONE) {
+                g.edges[n].push_back({node_of[idx], d});
+            }
+        });
+    }
 
-    std::cout << "1: " << dist[to] << std::endl;
+    return g;
 }
 
 
-void add_map_level(Mapa& mapa, Mapa const& level, Point::value_t const z)
+// BFS over the cells of the flat maze, portals jump to their pair. The
+// bidirectional one grows a layer from the smaller side until the two meet.
+unsigned bfs_path(Maze const& maze, bool bidirectional, size_t& expanded)
 {
-    for (auto [p0, tile] : level) {
-        Point p1 = p0;
-        p1.z = z;
-        if (tile.dest) {
-            Point& dest = tile.dest.value();
-            dest.z = z;
-            dest = dest + tile.up_down;
+    constexpr unsigned INF = std::numeric_limits<unsigned>::max();
+
+    std::vector<size_t> jump(maze.data.size(), Maze::NONE);
+    size_t from = 0, to = 0;
+    for (auto const& p : maze.portals) {
+        if (p.other != Maze::NONE) {
+            jump[p.cell] = maze.portals[p.other].cell;
+        } else if (p.id == AA) {
+            from = p.cell;
+        } else if (p.id == ZZ) {
+            to = p.cell;
+        }
+    }
+    if (from == to) {
+        return 0;
+    }
+
+    const size_t w = maze.width;
+    std::vector<unsigned> dist[2] = {std::vector<unsigned>(maze.data.size(), INF), std::vector<unsigned>(maze.data.size(), INF)};
+    std::vector<size_t> frontier[2] = {{from}, {to}}, next;
+    dist[0][from] = dist[1][to] = 0;
+
+    while (!frontier[0].empty() && (!bidirectional || !frontier[1].empty())) {
+        const int side = bidirectional && frontier[1].size() < frontier[0].size() ? 1 : 0;
+        auto const& mine = dist[side];
+        auto const& other = dist[1 - side];
+
+        unsigned best = INF;
+        next.clear();
+        for (const size_t c : frontier[side]) {
+            ++expanded;
+            for (const size_t n : {c - 1, c + 1, c - w, c + w, jump[c]}) {
+                if (n == Maze::NONE || !maze.open(n)) {
+                    continue;
+                }
+                if (other[n] != INF) {
+                    best = std::min(best, mine[c] + 1 + other[n]);
+                }
+                if (dist[side][n] == INF) {
+                    dist[side][n] = mine[c] + 1;
+                    next.push_back(n);
+                }
+            }
         }
-        if (tile.val == '.') {
-            mapa.insert({std::move(p1), std::move(tile)});
+        if (best != INF) {
+            return best;
         }
+        std::swap(frontier[side], next);
     }
-    // std::cout << "Added level " << z << std::endl;
+
+    return INF;
 }
 
 
-void part2(Mapa mapa)
+// Dijkstra over (portal, depth). Without recursion every portal stays on
+// level 0, with it inner portals go one level down, outer ones up, and a
+// depth gets its distances only once the search gets there.
+//
+// A* adds a lower bound of the rest of the way: the distance to ZZ with the
+// levels ignored, or, from deeper down, one outer portal hop per level.
+unsigned shortest_path(PortalGraph const& g, bool recursive, bool astar, size_t& expanded)
 {
-    resolve_outer(mapa);
-    Mapa mapa0 = mapa, mapaN = mapa;
-
-    // inner teleports go DOWN; outer go UP
-
-    // close outer teleports on level0
-    for (auto& [_, tile] : mapa0) {
-        if (tile.dest_name) {
-            if (tile.dest_name.value() == "AA" || tile.dest_name.value() == "ZZ") {
-                tile.up_down = Direction::NONE;
-            } else if (tile.up_down == Direction::UP) {
-                tile.val = '#';
-                tile.dest = std::nullopt;
-                tile.dest_name = std::nullopt;
-                tile.up_down = Direction::NONE;
-            }
+    constexpr unsigned INF = std::numeric_limits<unsigned>::max();
+
+    std::vector<unsigned> to_end(g.nodes.size(), 0);
+    unsigned hop = 0;  // cheapest way up a level: walk to an outer portal and take it
+    if (astar) {
+        size_t ignored = 0;
+        PortalGraph flat = g;
+        for (size_t n = 0; n < g.nodes.size(); ++n) {
+            flat.from = n;
+            to_end[n] = shortest_path(flat, false, false, ignored);
         }
-    }
 
-    // close AA and ZZ teleports on levelN
-    for (auto& [_, tile] : mapaN) {
-        if (tile.dest_name) {
-            if (tile.dest_name.value() == "AA" || tile.dest_name.value() == "ZZ") {
-                tile.val = '#';
-                tile.dest = std::nullopt;
-                tile.dest_name = std::nullopt;
-                tile.up_down = Direction::NONE;
+        hop = INF;
+        for (auto const& edges : g.edges) {
+            for (auto const& [to, dist] : edges) {
+                if (g.nodes[to].dz < 0) {
+                    hop = std::min(hop, dist + 1);
+                }
             }
         }
     }
+    // 64bit and saturated at INF, so adding it to a distance never wraps
+    auto estimate = [&](size_t n, int depth) -> uint64_t {
+        if (!astar) {
+            return 0;
+        }
+        if (depth == 0 || hop == INF) {
+            return depth == 0 ? to_end[n] : INF;  // no outer portal, no way up
+        }
+        // the first outer portal might be right here, so one walk less
+        const uint64_t up = uint64_t(depth) * hop - (hop - 1);
+        return std::min<uint64_t>(std::max<uint64_t>(to_end[n], up), INF);
+    };
 
-    Mapa the_map;
-    add_map_level(the_map, mapa0, 0);
-
-    for (int i = -1;; --i) {
-        add_map_level(the_map, mapaN, i);
-
-        auto g = create_graph(the_map);
+    std::vector<std::vector<unsigned>> best;
+    auto update = [&](size_t n, int depth, unsigned d) -> bool {
+        if (depth >= static_cast<int>(best.size())) {
+            best.resize(depth + 1, std::vector<unsigned>(g.nodes.size(), INF));
+        }
+        if (best[depth][n] <= d) {
+            return false;
+        }
+        best[depth][n] = d;
+        return true;
+    };
 
-        auto const& [from, to] = find_start_end(the_map);
+    using Item = std::tuple<uint64_t, unsigned, size_t, int>;  // estimate, distance, node, depth
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+    update(g.from, 0, 0);
+    queue.push({estimate(g.from, 0), 0, g.from, 0});
 
-        boost::dijkstra_shortest_paths(g, from, boost::distance_map(boost::get(boost::vertex_distance, g)));
+    while (!queue.empty()) {
+        auto const [_, d, n, depth] = queue.top();
+        queue.pop();
 
-        auto const& dist = boost::get(boost::vertex_distance, g);
+        if (n == g.to && depth == 0) {
+            return d;
+        }
+        if (best[depth][n] < d) {
+            continue;
+        }
+        ++expanded;
 
-        // for (auto const& [p, tile] : the_map) {
-        //     if (tile.dest) {
-        //         std::cout << "Gate from " << p << " is " << tile.up_down << " to " << tile.dest.value()
-        //                   << ", dist: " << dist[tile.vertex] << std::endl;
-        //     }
-        // }
+        for (auto const& [next, dist] : g.edges[n]) {
+            if (update(next, depth, d + dist)) {
+                queue.push({d + dist + estimate(next, depth), d + dist, next, depth});
+            }
+        }
 
-        if (dist[to] < 4294967295) {
-            std::cout << "2: " << dist[to] << std::endl;
-            break;
+        auto const& node = g.nodes[n];
+        const int next_depth = recursive ? depth + node.dz : 0;
+        if (node.other != PortalGraph::NONE && next_depth >= 0 && update(node.other, next_depth, d + 1)) {
+            queue.push({d + 1 + estimate(node.other, next_depth), d + 1, node.other, next_depth});
         }
     }
+
+    return INF;
+}
+
+
+void part1(Maze const& maze, bool plain)
+{
+    size_t expanded = 0;
+    const unsigned result = bfs_path(maze, !plain, expanded);
+    std::cout << "Expanded: " << expanded << std::endl;
+    std::cout << "1: " << result << std::endl;
+}
+
+
+void part2(PortalGraph const& g, bool plain)
+{
+    size_t expanded = 0;
+    const unsigned result = shortest_path(g, true, !plain, expanded);
+    std::cout << "Expanded: " << expanded << std::endl;
+    std::cout << "2: " << result << std::endl;
 }
 
 
 int main(int argc, char* argv[])
 {
-    Mapa mapa = load_map();
+    // -p searches with plain BFS and Dijkstra instead of bidirectional BFS and A*
+    const bool plain = argc > 1 && std::string(argv[1]) == "-p";
 
-    resolve_teleports(mapa);
+    const Maze maze = load_map();
+    const PortalGraph g = contract(maze);
 
-    part1(mapa);
-    part2(mapa);
+    part1(maze, plain);
+    part2(g, plain);
 
     return 0;
 }
@@ -7,6 +7,7 @@
 #include <list>
 #include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using Program = std::map<int64_t, int64_t>;
@@ -31,9 +32,19 @@ struct Unit
 
     Ret run();
 
+    // ASCII channel: whole lines in, whole screens out, without returning
+    // from the VM per character.
+    void feed(std::string_view line);
+    std::string_view read_until_prompt(size_t limit = 0);
+    Ret state = Ret::INPUT;
+
 protected:
     friend struct Param;
 
+    std::string ascii_in, ascii_out;
+    size_t ascii_pos = 0, ascii_limit = 0;
+    bool ascii = false;
+
     int64_t get_val(int64_t _ip);
     int64_t get_param(int64_t _ip, char mode);
     void set_param(int64_t _ip, int64_t value);
@@ -109,6 +120,29 @@ void Unit::set_param(int64_t _ip, int64_t value)
     program[_ip] = value;
 }
 
+void Unit::feed(std::string_view line)
+{
+    if (ascii_pos == ascii_in.size()) {
+        ascii_in.clear();
+        ascii_pos = 0;
+    }
+    ascii_in.append(line);
+    ascii_in.push_back('\n');
+}
+
+// Returns everything printed until the program wants more input. A non-ASCII
+// value (or hitting the limit) stops the run with state == Ret::OUTPUT, the
+// value itself is left in the regular output.
+std::string_view Unit::read_until_prompt(size_t limit)
+{
+    ascii_out.clear();
+    ascii_limit = limit;
+    ascii = true;
+    state = run();
+    ascii = false;
+    return ascii_out;
+}
+
 Ret Unit::run()
 {
     try {
@@ -133,15 +167,26 @@ Ret Unit::run()
                 p3.set(p1() * p2());
                 ip += 4;
             } else if (cmd == "30") {
-                if (io.empty()) {
+                if (!io.empty()) {
+                    p1.set(io.back());
+                    io.pop_back();
+                } else if (ascii_pos < ascii_in.size()) {
+                    p1.set(ascii_in[ascii_pos++]);
+                } else {
                     return Ret::INPUT;
                 }
-                p1.set(io.back());
-                io.pop_back();
                 ip += 2;
             } else if (cmd == "40") {
-                io.push_front(p1());
+                const auto v = p1();
                 ip += 2;
+                if (ascii && v >= 0 && v < 128) {
+                    ascii_out.push_back(v);
+                    if (ascii_limit && ascii_out.size() > ascii_limit) {
+                        return Ret::OUTPUT;
+                    }
+                    continue;
+                }
+                io.push_front(v);
                 return Ret::OUTPUT;
             } else if (cmd == "50") {  // jump-if-true
                 if (p1()) {
@@ -193,54 +238,39 @@ std::ostream& operator<<(std::ostream& os, Ret const& r)
 }  // namespace std
 
 
-void run_springscript(Unit unit, const std::string& feed)
+void run_springscript(Unit unit, const std::vector<std::string_view>& script)
 {
-    Ret res = unit.run();
-    while (res == Ret::OUTPUT) {
-        std::cout << (char)unit.io.front();
-        unit.io.clear();
-        res = unit.run();
-    }
+    std::cout << unit.read_until_prompt() << std::endl;
+    assert(unit.state == Ret::INPUT);
 
-    std::cout << std::endl;
-
-    for (auto const& c : feed) {
-        assert(res == Ret::INPUT);
-        unit.io.push_front(c);
-        res = unit.run();
-        if (res == Ret::INPUT) {
-            continue;
-        }
+    for (auto const& line : script) {
+        unit.feed(line);
     }
 
     std::cout << std::endl;
 
-    while (res == Ret::OUTPUT) {
-        auto const& v = unit.io.front();
-        if (v > 127) {
-            std::cout << v;
-        } else {
-            std::cout << static_cast<unsigned char>(v);
+    for (;;) {
+        std::cout << unit.read_until_prompt();
+        if (unit.state != Ret::OUTPUT) {
+            break;
         }
+        std::cout << unit.io.front();
         unit.io.clear();
-        res = unit.run();
     }
 
-    assert(res == Ret::EXIT);
+    assert(unit.state == Ret::EXIT);
 
     std::cout << std::endl;
 }
 
 void run1(Unit unit)
 {
-    const std::string feed = {"OR C J\nAND B J\nAND A J\nNOT J J\nAND D J\nWALK\n"};
-    run_springscript(unit, feed);
+    run_springscript(unit, {"OR C J", "AND B J", "AND A J", "NOT J J", "AND D J", "WALK"});
 }
 
 void run2(Unit unit)
 {
-    const std::string feed = {"OR C J\nAND B J\nAND A J\nNOT J J\nAND D J\nOR H T\nOR E T\nAND T J\nRUN\n"};
-    run_springscript(unit, feed);
+    run_springscript(unit, {"OR C J", "AND B J", "AND A J", "NOT J J", "AND D J", "OR H T", "OR E T", "AND T J", "RUN"});
 }
 
 int main(int argc, char* argv[])
@@ -9,7 +9,9 @@
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <list>
+#include <optional>
 #include <map>
 #include <string>
 #include <unordered_map>
@@ -23,6 +25,7 @@ enum class Ret : int
     EXIT = 1,
     INPUT = 2,
     OUTPUT = 3,
+    YIELD = 4,
 };
 
 struct Param;
@@ -35,6 +38,9 @@ struct Unit
     Program program;
     IO input, output;
 
+    // instructions left before run() returns Ret::YIELD
+    uint64_t budget = std::numeric_limits<uint64_t>::max();
+
     Ret run();
 
 protected:
@@ -118,7 +124,11 @@ void Unit::set_param(int64_t _ip, int64_t value)
 Ret Unit::run()
 {
     try {
-        for (;;) {
+        for (;; --budget) {
+            if (budget == 0) {
+                return Ret::YIELD;
+            }
+
             auto s = std::to_string(program.at(ip));
             std::reverse(std::begin(s), std::end(s));
             while (s.size() < 5) {
@@ -184,115 +194,154 @@ Ret Unit::run()
 }
 
 
-void run1(Unit unit)
+struct Packet
 {
-    std::map<unsigned, Unit> network;
-    for (unsigned i = 0; i < 50; ++i) {
-        auto [it, _] = network.insert({i, unit});
-        it->second.input.push_back(i); // 1st input is the NIC id
-    }
+    int64_t dst = 0, x = 0, y = 0;
+};
 
-    for(;;) {
-        for (auto& [id, nic] : network) {
-            auto ret = nic.run();
-            if (ret == Ret::INPUT) {
-                nic.input.push_front(-1);
-            } else if (ret == Ret::OUTPUT) {
-                const auto dst = nic.output.front();
-                nic.output.pop_front();
-
-                ret = nic.run(); // expect X
-                assert(ret == Ret::OUTPUT);
-                const auto X = nic.output.front();
-                nic.output.pop_front();
-
-
-                ret = nic.run(); // expect Y
-                assert(ret == Ret::OUTPUT);
-                const auto Y = nic.output.front();
-                nic.output.pop_front();
-
-                if (dst == 255) {
-                    std::cout << "1: " << Y << std::endl;
-                    return;
-                }
+// Only NICs with something to do are scheduled. A NIC that asks for input
+// twice in a row without sending anything is just polling, so it gets parked
+// until a packet arrives for it.
+struct Network
+{
+    static constexpr unsigned SIZE = 50;
+    static constexpr uint64_t QUANTUM = 1000;
 
-                assert(dst < 50);
-                auto& target = network.at(dst);
-                target.input.push_back(X);
-                target.input.push_back(Y);
-            } else {
-                assert(ret == Ret::EXIT);
-                std::cout << "END of " << id << " ? " << std::endl;
-            }
-        }
+    explicit Network(Unit const& unit);
+
+    // Runs until a packet for 255 shows up, nullopt means the network is idle.
+    std::optional<Packet> run();
+    void send(Packet const& p);
+
+protected:
+    struct Nic
+    {
+        Unit unit;
+        IO out;
+        bool polled = false, queued = false;
+    };
+
+    std::vector<Nic> nics;
+    std::deque<unsigned> ready;
+
+    void wake(unsigned id);
+};
+
+Network::Network(Unit const& unit)
+    : nics(SIZE, Nic {unit})
+{
+    for (unsigned i = 0; i < SIZE; ++i) {
+        nics.at(i).unit.input.push_back(i); // 1st input is the NIC id
+        wake(i);
     }
 }
 
-
-void run2(Unit unit)
+void Network::wake(unsigned id)
 {
-    std::map<unsigned, Unit> network;
-    for (unsigned i = 0; i < 50; ++i) {
-        auto [it, _] = network.insert({i, unit});
-        it->second.input.push_back(i); // 1st input is the NIC id
+    auto& nic = nics.at(id);
+    if (!nic.queued) {
+        nic.queued = true;
+        ready.push_back(id);
     }
+}
 
-    int64_t NAT_X = -1, NAT_Y = -1;
-    int64_t NAT_X2 = 0, NAT_Y2 = 0;
+void Network::send(Packet const& p)
+{
+    assert(p.dst >= 0 && p.dst < SIZE);
+    auto& nic = nics.at(p.dst);
+    nic.unit.input.push_back(p.x);
+    nic.unit.input.push_back(p.y);
+    nic.polled = false;
+    wake(p.dst);
+}
 
-    for(;;) {
+std::optional<Packet> Network::run()
+{
+    while (!ready.empty()) {
+        const auto id = ready.front();
+        ready.pop_front();
+
+        auto& nic = nics.at(id);
+        nic.queued = false;
+        nic.unit.budget = QUANTUM;
+
+        for (bool turn = true; turn;) {
+            switch (nic.unit.run()) {
+            case Ret::OUTPUT:
+                nic.polled = false;
+                nic.out.push_back(nic.unit.output.front());
+                nic.unit.output.pop_front();
+                if (nic.out.size() < 3) {
+                    break;
+                }
+                {
+                    Packet p;
+                    p.dst = nic.out.front(); nic.out.pop_front();
+                    p.x = nic.out.front(); nic.out.pop_front();
+                    p.y = nic.out.front(); nic.out.pop_front();
+                    if (p.dst == 255) {
+                        wake(id);
+                        return p;
+                    }
+                    send(p);
+                }
+                break;
+            case Ret::INPUT:
+                if (nic.polled) {
+                    turn = false; // parked, send() wakes it up
+                    break;
+                }
+                nic.polled = true;
+                nic.unit.input.push_back(-1);
+                break;
+            case Ret::YIELD:
+                wake(id);
+                turn = false;
+                break;
+            case Ret::EXIT:
+                std::cout << "END of " << id << " ? " << std::endl;
+                turn = false;
+                break;
+            }
+        }
+    }
 
-        unsigned hungry = 0;
+    return std::nullopt;
+}
 
-        for (auto& [id, nic] : network) {
-            auto ret = nic.run();
-            if (ret == Ret::INPUT) {
-                nic.input.push_front(-1);
-                ++hungry;
-            } else if (ret == Ret::OUTPUT) {
-                const auto dst = nic.output.front();
-                nic.output.pop_front();
 
-                ret = nic.run(); // expect X
-                assert(ret == Ret::OUTPUT);
-                const auto X = nic.output.front();
-                nic.output.pop_front();
+void run1(Unit unit)
+{
+    Network network {unit};
 
+    auto p = network.run();
+    assert(p);
+    std::cout << "1: " << p->y << std::endl;
+}
 
-                ret = nic.run(); // expect Y
-                assert(ret == Ret::OUTPUT);
-                const auto Y = nic.output.front();
-                nic.output.pop_front();
 
-                if (dst == 255) {
-                    NAT_X = X;
-                    NAT_Y = Y;
-                } else {
-                    assert(dst < 50);
-                    auto& target = network.at(dst);
-                    target.input.push_back(X);
-                    target.input.push_back(Y);
-                }
-            } else {
-                assert(ret == Ret::EXIT);
-                std::cout << "END of " << id << " ? " << std::endl;
-            }
-        }
+void run2(Unit unit)
+{
+    Network network {unit};
 
-        if (hungry == 50) {
-            if (NAT_X == NAT_X2 && NAT_Y == NAT_Y2) {
-                std::cout << "2: " << NAT_Y << std::endl;
-                return;
-            }
+    std::optional<Packet> nat;
+    int64_t last_y = 0;
 
-            auto& target = network.at(0);
-            target.input.push_back(NAT_X);
-            target.input.push_back(NAT_Y);
+    for(;;) {
+        if (auto p = network.run()) {
+            nat = p;
+            continue;
+        }
 
-            NAT_X2 = NAT_X;
-            NAT_Y2 = NAT_Y;
+        // the whole network is idle
+        assert(nat);
+        if (nat->y == last_y) {
+            std::cout << "2: " << nat->y << std::endl;
+            return;
         }
+
+        last_y = nat->y;
+        network.send({0, nat->x, nat->y});
     }
 }
 
@@ -1,642 +1,512 @@
 #include <algorithm>
-#include <boost/config.hpp>
-#include <boost/container_hash/hash.hpp>
-
+#include <array>
+#include <bit>
 #include <cassert>
+#include <cstdint>
 #include <functional>
 #include <iostream>
-#include <memory>
-#include <numeric>
-#include <ostream>
-#include <sstream>
-#include <unordered_map>
-#include <unordered_set>
+#include <set>
+#include <string>
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_reduce.h>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 
-struct Direction
-{
-    using value_t = int;
-
-    Direction()
-        : Direction(NONE)
-    { }
-
-    Direction(value_t _dx, value_t _dy, value_t _dz) noexcept : dx{_dx}, dy{_dy}, dz{_dz} {}
-
-    value_t get_dx() const noexcept { return dx; }
-    value_t get_dy() const noexcept { return dy; }
-    value_t get_dz() const noexcept { return dz; }
+__extension__ using uint128_t = unsigned __int128;
 
-    bool operator==(const Direction& o) const noexcept { return dx == o.dx && dy == o.dy && dz == o.dz; }
 
-    static Direction oposite(Direction const& d) noexcept
-    {
-        if (d == Direction::NORTH) return Direction::SOUTH;
-        if (d == Direction::SOUTH) return Direction::NORTH;
-        if (d == Direction::EAST) return Direction::WEST;
-        if (d == Direction::WEST) return Direction::EAST;
-        if (d == Direction::UP) return Direction::DOWN;
-        if (d == Direction::DOWN) return Direction::UP;
-
-        assert(false);
-    }
-
-    static const Direction NONE, NORTH, SOUTH, EAST, WEST, UP, DOWN;
-protected:
-    value_t dx = 0, dy = 0, dz = 0;
+// Cells that come to life and cells that stay alive, bit k set for k
+// neighbours. Bugs is the puzzle: born next to 1 or 2, surviving next to 1.
+template<unsigned BIRTH, unsigned SURVIVE>
+struct Rule
+{
+    static constexpr unsigned birth = BIRTH, survive = SURVIVE;
 };
 
-const Direction Direction::NONE {0, 0, 0};
-const Direction Direction::NORTH {0, -1, 0};
-const Direction Direction::SOUTH {0, +1, 0};
-const Direction Direction::EAST {+1, 0, 0};
-const Direction Direction::WEST {-1, 0, 0};
-const Direction Direction::UP {0, 0, 1};
-const Direction Direction::DOWN {0, 0, -1};
+using Bugs = Rule<0b110, 0b010>;
 
 
-struct Point
+// NxN grid as the low N * N bits of the smallest unsigned integer that fits,
+// cell (x, y) is bit y * N + x. That makes the biodiversity rating the board
+// itself. In the recursive grid the HOLExHOLE square in the middle is the
+// inner level; all masks are compile time constants of the configuration.
+template<unsigned N, unsigned HOLE, typename R = Bugs>
+struct Grid
 {
-    using value_t = int64_t;
-
-    value_t x = -1, y = -1, z = -1;
+    static_assert(N % 2 == 1 && HOLE % 2 == 1 && HOLE + 4 <= N, "hole needs a ring of cells around it");
 
-    Point() = default;
+    using Board = std::conditional_t<N * N <= 32, uint32_t, std::conditional_t<N * N <= 64, uint64_t, uint128_t>>;
 
-    constexpr Point(value_t x_, value_t y_, value_t z_) noexcept
-        : x {x_}
-        , y {y_}
-        , z {z_}
-    { }
-
-    constexpr Point(value_t x_, value_t y_) noexcept : Point(x_, y_, 0) {}
+    static constexpr unsigned CELLS = N * N;
+    static constexpr unsigned LO = (N - HOLE) / 2, HI = LO + HOLE - 1;  // first and last cell of the hole
 
-    bool operator==(Point const& o) const noexcept
+    static constexpr Board bit(unsigned x, unsigned y) noexcept
     {
-        return x == o.x && y == o.y && z == o.z;
+        return Board {1} << (y * N + x);
     }
 
-    bool empty() const noexcept { return x == -1 && y == -1 && z == -1; }
-
-    operator bool() const noexcept { return !empty(); }
-};
-
-
-Point operator+(Point const& p, Direction const& d) noexcept
-{
-    return {p.x + d.get_dx(), p.y + d.get_dy(), p.z + d.get_dz()};
-}
-
-
-using Mapa = std::unordered_map<Point, unsigned char>;
-
-
-namespace std {
+    static constexpr Board ALL = (Board {1} << (CELLS - 1) << 1) - 1;
 
-template<>
-struct hash<Point>
-{
-    size_t operator()(Point const& p) const noexcept
+    // cells of a row / column, `part` picks the ones next to one cell of the hole edge
+    static constexpr Board row(unsigned y, int part = -1) noexcept
     {
-        size_t seed = 0;
-        boost::hash_combine(seed, p.x);
-        boost::hash_combine(seed, p.y);
-        boost::hash_combine(seed, p.z);
-        return seed;
-    }
-};
-
-}  // namespace std
-
-
-std::tuple<Point::value_t, Point::value_t, Point::value_t, Point::value_t, Point::value_t, Point::value_t> mapa_min_max(
-    Mapa const& mapa)
-{
-    Point::value_t min_x = std::numeric_limits<Point::value_t>::max(),
-                   min_y = std::numeric_limits<Point::value_t>::max(),
-                   min_z = std::numeric_limits<Point::value_t>::max(),
-                   max_x = std::numeric_limits<Point::value_t>::min(),
-                   max_y = std::numeric_limits<Point::value_t>::min(),
-                   max_z = std::numeric_limits<Point::value_t>::min();
-    for (auto const& [px, _] : mapa) {
-        min_x = std::min(min_x, px.x);
-        min_y = std::min(min_y, px.y);
-        min_z = std::min(min_z, px.z);
-        max_x = std::max(max_x, px.x);
-        max_y = std::max(max_y, px.y);
-        max_z = std::max(max_z, px.z);
+        Board b = 0;
+        for (unsigned x = 0; x < N; ++x) {
+            if (part < 0 || x * HOLE / N == unsigned(part)) {
+                b |= bit(x, y);
+            }
+        }
+        return b;
     }
-    return std::tie(min_x, min_y, min_z, max_x, max_y, max_z);
-    // return {0, 0, 0, 4, 4, 0};
-}
-
 
-std::string to_string(Mapa const& mapa, Point::value_t z = 0)
-{
-    std::stringstream ss;
-
-    auto const& [min_x, min_y, min_z, max_x, max_y, max_z] = mapa_min_max(mapa);
-    for (Point::value_t y = min_y; y <= max_y; ++y) {
-        for (Point::value_t x = min_x; x <= max_x; ++x) {
-            auto it = mapa.find({x, y, z});
-            if (it == mapa.end()) {
-                ss << "?";
-                continue;
+    static constexpr Board column(unsigned x, int part = -1) noexcept
+    {
+        Board b = 0;
+        for (unsigned y = 0; y < N; ++y) {
+            if (part < 0 || y * HOLE / N == unsigned(part)) {
+                b |= bit(x, y);
             }
-            ss << it->second;
         }
-        ss << "\n";
+        return b;
     }
-    return ss.str();
-}
-
 
-namespace std {
-
-template<>
-struct hash<Mapa>
-{
-    size_t operator()(Mapa const& m) const noexcept
+    static constexpr Board hole() noexcept
     {
-        return std::hash<std::string>()(to_string(m));
+        Board b = 0;
+        for (unsigned y = LO; y <= HI; ++y) {
+            for (unsigned x = LO; x <= HI; ++x) {
+                b |= bit(x, y);
+            }
+        }
+        return b;
     }
-};
-
 
-std::ostream& operator<<(std::ostream& os, Point const& p)
-{
-    os << "(" << p.x << "; " << p.y << "; " << p.z << ")";
-    return os;
-}
-
-std::ostream& operator<<(std::ostream& os, Direction const& d)
-{
-    if (d == Direction::NONE) {
-        os << "NONE";
-    } else if (d == Direction::WEST) {
-        os << "WEST";
-    } else if (d == Direction::EAST) {
-        os << "EAST";
-    } else if (d == Direction::NORTH) {
-        os << "NORTH";
-    } else if (d == Direction::SOUTH) {
-        os << "SOUTH";
-    } else if (d == Direction::UP) {
-        os << "UP";
-    } else if (d == Direction::DOWN) {
-        os << "DOWN";
-    } else {
-        assert(false);
+    template<typename F>
+    static constexpr std::array<Board, HOLE> parts(F&& f) noexcept
+    {
+        std::array<Board, HOLE> a {};
+        for (unsigned j = 0; j < HOLE; ++j) {
+            a[j] = f(j);
+        }
+        return a;
     }
-    return os;
-}
 
+    static constexpr Board FIRST_COLUMN = column(0), LAST_COLUMN = column(N - 1);
+    static constexpr Board HOLE_MASK = hole();
+    static constexpr Board BORDER = row(0) | row(N - 1) | FIRST_COLUMN | LAST_COLUMN;
+    static constexpr Board AROUND_HOLE = ((HOLE_MASK << N) | (HOLE_MASK >> N) | (HOLE_MASK << 1) | (HOLE_MASK >> 1)) & ~HOLE_MASK;
 
-}  // namespace std
-
-
-
-void dump(Mapa const& mapa, Point::value_t z = 0)
-{
-    std::cout << "-------------------------------------------------------------------------------\n";
-    std::cout << to_string(mapa, z);
-    std::cout << "-------------------------------------------------------------------------------\n";
-}
-
+    // edges of a level split by the cell of the hole edge they are next to
+    static constexpr auto TOP = parts([](unsigned j) { return row(0, j); });
+    static constexpr auto BOTTOM = parts([](unsigned j) { return row(N - 1, j); });
+    static constexpr auto LEFT = parts([](unsigned j) { return column(0, j); });
+    static constexpr auto RIGHT = parts([](unsigned j) { return column(N - 1, j); });
 
-Mapa load_map()
-{
-    Mapa mapa;
-    Point p0 {0, 0, 0};
-
-    std::string line;
-    while (std::getline(std::cin, line)) {
-        if (line.empty()) {
-            break;
-        }
-        for (auto c : line) {
-            mapa.insert({p0, c});
-            ++p0.x;
+    static unsigned popcount(Board b) noexcept
+    {
+        if constexpr (sizeof(Board) > sizeof(uint64_t)) {
+            return std::popcount(uint64_t(b)) + std::popcount(uint64_t(b >> 64));
+        } else {
+            return std::popcount(b);
         }
-        p0.x = 0;
-        ++p0.y;
     }
-    return mapa;
-}
 
+    // all ones when set
+    static Board spread(bool set) noexcept
+    {
+        return Board {0} - set;
+    }
 
-void part1(Mapa mapa)
-{
-    std::unordered_set<Mapa> seen;
-
-    seen.insert(mapa);
-
-    for (;;) {
-        Mapa m2;
-        for (auto const& [px, c] : mapa) {
-            assert(px.z == 0);
-            const auto north = px + Direction::NORTH;
-            const auto south = px + Direction::SOUTH;
-            const auto west = px + Direction::WEST;
-            const auto east = px + Direction::EAST;
-
-            unsigned around = 0;
-            if (mapa.contains(north) && mapa.at(north) == '#') {
-                ++around;
-            }
-            if (mapa.contains(south) && mapa.at(south) == '#') {
-                ++around;
-            }
-            if (mapa.contains(west) && mapa.at(west) == '#') {
-                ++around;
-            }
-            if (mapa.contains(east) && mapa.at(east) == '#') {
-                ++around;
-            }
+    // The four neighbour boards added up bit-sliced, every cell gets its
+    // count in three bit planes.
+    struct Count
+    {
+        Board bit0, bit1, bit2;
 
-            if (c == '.' && (around == 1 || around == 2)) {
-                m2[px] = '#';
-            } else if (c == '#' && around != 1) {
-                m2[px] = '.';
-            } else {
-                m2[px] = c;
-            }
+        Count(Board n, Board s, Board w, Board e) noexcept
+        {
+            const Board s1 = n ^ s, c1 = n & s;
+            const Board s2 = w ^ e, c2 = w & e;
+            const Board carry = s1 & s2;
+            bit0 = s1 ^ s2;
+            bit1 = c1 ^ c2 ^ carry;
+            bit2 = (c1 & c2) | ((c1 ^ c2) & carry);
         }
 
-        std::swap(mapa, m2);
-
-        if (!seen.insert(mapa).second)
+        template<unsigned K>
+        Board equals() const noexcept
         {
-            break;
+            return ((K & 1) ? bit0 : ~bit0) & ((K & 2) ? bit1 : ~bit1) & ((K & 4) ? bit2 : ~bit2);
         }
-    }
 
-    int64_t result = 0, increment = 1;
-
-    auto const& [min_x, min_y, min_z, max_x, max_y, max_z] = mapa_min_max(mapa);
-    for (Point::value_t y = min_y; y <= max_y; ++y) {
-        for (Point::value_t x = min_x; x <= max_x; ++x, increment <<= 1) {
-            auto it = mapa.find({x, y, 0});
-            if (it == mapa.end()) {
-                continue;
-            }
-            if (it->second == '#') {
-                result += increment;
-            }
+        unsigned at(Board cell) const noexcept
+        {
+            return ((bit0 & cell) != 0) + 2 * ((bit1 & cell) != 0) + 4 * ((bit2 & cell) != 0);
         }
-    }
 
-    std::cout << "1: " << result << std::endl;
-    // -------------------------------------------------------------------------------
-    // ....#
-    // ....#
-    // ##..#
-    // ##..#
-    // .#..#
-    // -------------------------------------------------------------------------------
-    // 1: 19516944
-}
-
-
-struct Level;
-using LevelPtr = std::unique_ptr<Level>;
-
-
-struct Level
-{
-    Level() noexcept {
-        for (int64_t y = 0; y <= MAX_Y; ++y) {
-            for (int64_t x = 0; x <= MAX_X; ++x) {
-                if (x == INNER_X && y == INNER_Y) {
-                    continue;
-                }
-                m1.insert({{x, y}, '.'});
-            }
+        // only the counts the rule uses make it into the kernel
+        Board apply(Board b) const noexcept
+        {
+            return [&]<unsigned... K>(std::integer_sequence<unsigned, K...>) {
+                Board survive = 0, birth = 0;
+                ((survive |= ((R::survive >> K) & 1) ? equals<K>() : 0), ...);
+                ((birth |= ((R::birth >> K) & 1) ? equals<K>() : 0), ...);
+                return ((b & survive) | (~b & birth)) & ALL;
+            }(std::make_integer_sequence<unsigned, 5> {});
         }
-    }
+    };
 
-    Level(Mapa _m) noexcept
-        : m1 {std::move(_m)}
+    static bool alive(bool was, unsigned count) noexcept
     {
-        m1.erase({2, 2}); // remove the inner point
+        return ((was ? R::survive : R::birth) >> count) & 1;
     }
 
-    unsigned char get(Point const& px) const { return m1.at(px); }
-
-    unsigned int count_all_north() const noexcept
+    // the flat grid, no levels
+    static Board step(Board b) noexcept
     {
-        return count_all({0, 0}, Direction::EAST);
+        const Count c((b << N) & ALL, b >> N, (b << 1) & ~FIRST_COLUMN & ALL, (b >> 1) & ~LAST_COLUMN);
+        return c.apply(b);
     }
 
-    unsigned int count_all_south() const noexcept
+    // One level of the recursive grid. The hole stays empty, the outer level
+    // is seen around the border and the edges of the inner level around the
+    // hole. Everything is masks and arithmetic, no branches. Forced inline
+    // into the level loop, the bigger templated kernel is not by default.
+    [[gnu::always_inline]] static Board step(Board outer, Board b, Board inner) noexcept
     {
-        return count_all({MAX_X, MAX_Y}, Direction::WEST);
-    }
-
-    unsigned int count_all_west() const noexcept
-    {
-        return count_all({0, 0}, Direction::SOUTH);
-    }
+        Board n = (b << N) & ALL, s = b >> N, w = (b << 1) & ~FIRST_COLUMN & ALL, e = (b >> 1) & ~LAST_COLUMN;
+        for (unsigned j = 0; j < HOLE; ++j) {
+            n |= TOP[j] & spread(outer & bit(LO + j, LO - 1));
+            s |= BOTTOM[j] & spread(outer & bit(LO + j, HI + 1));
+            w |= LEFT[j] & spread(outer & bit(LO - 1, LO + j));
+            e |= RIGHT[j] & spread(outer & bit(HI + 1, LO + j));
+        }
 
-    unsigned int count_all_east() const noexcept
-    {
-        return count_all({MAX_X, MAX_Y}, Direction::NORTH);
-    }
+        const Count c(n, s, w, e);
+        Board next = c.apply(b);
+
+        // the cells next to the hole also see a part of an edge of the inner level
+        auto fix = [&](Board cell, Board inner_edge) {
+            const bool now = alive(b & cell, c.at(cell) + popcount(inner & inner_edge));
+            next = (next & ~cell) | (cell & spread(now));
+        };
+        for (unsigned j = 0; j < HOLE; ++j) {
+            fix(bit(LO + j, LO - 1), TOP[j]);
+            fix(bit(LO + j, HI + 1), BOTTOM[j]);
+            fix(bit(LO - 1, LO + j), LEFT[j]);
+            fix(bit(HI + 1, LO + j), RIGHT[j]);
+        }
 
-    bool empty() const noexcept {
-        return std::all_of(m1.begin(), m1.end(), [](auto const& i) { return i.second == '.'; });
+        return next & ~HOLE_MASK;
     }
 
-    void swap_maps() noexcept {
-        std::swap(m1, m2);
-        m2 = {};
+    static Board load_map()
+    {
+        Board b = 0;
+        unsigned y = 0;
+
+        std::string line;
+        while (std::getline(std::cin, line) && !line.empty() && y < N) {
+            for (unsigned x = 0; x < N && x < line.size(); ++x) {
+                if (line[x] == '#') {
+                    b |= bit(x, y);
+                }
+            }
+            ++y;
+        }
+        return b;
     }
 
-    unsigned bug_count() const noexcept {
-        unsigned cnt {0};
-        for (auto const& [_, c] : m1) {
-            if (c == '#') {
-                ++cnt;
+    static void dump(Board b)
+    {
+        std::cout << "-------------------------------------------------------------------------------\n";
+        for (unsigned y = 0; y < N; ++y) {
+            for (unsigned x = 0; x < N; ++x) {
+                std::cout << ((b & bit(x, y)) ? '#' : '.');
             }
+            std::cout << "\n";
         }
-        return cnt;
+        std::cout << "-------------------------------------------------------------------------------\n";
     }
 
-    void step() noexcept
+    static std::string to_string(Board b)
     {
-        static constexpr Point outer_north{2, 1};
-        static constexpr Point outer_south{2, 3};
-        static constexpr Point outer_west{1, 2};
-        static constexpr Point outer_east{3, 2};
-
-        for (auto const& [px, c] : m1) {
-            assert(px.z == 0);
-            assert(!(px == Point{INNER_X, INNER_Y, 0}));
+        std::string s;
+        do {
+            s += '0' + unsigned(b % 10);
+            b /= 10;
+        } while (b);
+        std::reverse(s.begin(), s.end());
+        return s;
+    }
+};
 
-            unsigned around = 0;
 
-            // std::cout << std::hex << this << std::dec << "; Examine " << px << ", c: " << c << "; ";
+template<typename G>
+void part1(typename G::Board b)
+{
+    if constexpr (G::CELLS <= 25) {
+        // one bit for every possible board
+        std::vector<uint64_t> seen((size_t {1} << G::CELLS) / 64 + 1, 0);
+        auto check = [&seen](uint64_t board) -> bool {
+            const uint64_t mask = uint64_t {1} << (board % 64);
+            const bool was = seen[board / 64] & mask;
+            seen[board / 64] |= mask;
+            return was;
+        };
+        while (!check(b)) {
+            b = G::step(b);
+        }
+    } else {
+        std::set<typename G::Board> seen;
+        while (seen.insert(b).second) {
+            b = G::step(b);
+        }
+    }
 
-            const Point north = px + Direction::NORTH;
-            const Point south = px + Direction::SOUTH;
-            const Point west = px + Direction::WEST;
-            const Point east = px + Direction::EAST;
+    std::cout << "1: " << G::to_string(b) << std::endl;
+}
 
 
-            if (north.y < MIN_Y) {
-                if (outer && outer->get(outer_north) == '#') {
-                    // std::cout << "check outer_north; ";
-                    ++around;
-                }
-            } else if (north.x == INNER_X && north.y == INNER_Y) {
-                if (inner) {
-                    // std::cout << "check all_south; ";
-                    around += inner->count_all_south();
-                }
-            } else if (m1.contains(north) && m1.at(north) == '#') {
-                // std::cout << "check one_north; ";
-                ++around;
-            }
+// Transitions seen before, by the parts of the neighbours a level actually
+// looks at: the cells of the outer level around the hole and the border of
+// the inner one. Direct mapped, a new triple replaces whatever was in its
+// slot. A board never has cells in the hole, that marks the empty slots.
+template<typename G>
+struct Transitions
+{
+    using Board = typename G::Board;
 
+    static constexpr unsigned BITS = 16;
 
-            if (south.y > MAX_Y) {
-                if (outer && outer->get(outer_south) == '#') {
-                    // std::cout << "check outer_south; ";
-                    ++around;
-                }
-            } else if (south.x == INNER_X && south.y == INNER_Y) {
-                if (inner) {
-                    // std::cout << "check all_north; ";
-                    around += inner->count_all_north();
-                }
-            } if (m1.contains(south) && m1.at(south) == '#') {
-                // std::cout << "check one_south; ";
-                ++around;
-            }
+    struct Entry
+    {
+        Board outer, self, inner, next;
+    };
 
+    Transitions()
+        : table(size_t {1} << BITS, Entry {0, G::HOLE_MASK, 0, 0})
+    { }
 
-            if (west.x < MIN_X) {
-                if (outer && outer->get(outer_west) == '#') {
-                    // std::cout << "check outer_west; ";
-                    ++around;
-                }
-            } else if (west.x == INNER_X && west.y == INNER_Y) {
-                if (inner) {
-                    // std::cout << "check all_west; ";
-                    around += inner->count_all_east();
-                }
-            } else if (m1.contains(west) && m1.at(west) == '#') {
-                // std::cout << "check one_west; ";
-                ++around;
-            }
+    Board step(Board outer, Board self, Board inner) noexcept
+    {
+        outer &= G::AROUND_HOLE;
+        inner &= G::BORDER;
 
+        Entry& e = table[hash(outer, self, inner)];
+        if (e.self == self && e.outer == outer && e.inner == inner) {
+            ++hits;
+            return e.next;
+        }
+        ++misses;
+        e = {outer, self, inner, G::step(outer, self, inner)};
+        return e.next;
+    }
 
-            if (east.x > MAX_X) {
-                if (outer && outer->get(outer_east) == '#') {
-                    // std::cout << "check outer_east; ";
-                    ++around;
-                }
-            } else if (east.x == INNER_X && east.y == INNER_Y) {
-                if (inner) {
-                    // std::cout << "check all_east; ";
-                    around += inner->count_all_west();
-                }
-            } else if (m1.contains(east) && m1.at(east) == '#') {
-                // std::cout << "check one_east; ";
-                ++around;
-            }
+    size_t hits = 0, misses = 0;
 
-            // std::cout << "; around=" << around << "; ";
-
-            if (c == '.' && (around == 1 || around == 2)) {
-                m2[px] = '#';
-                // std::cout << "born";
-            } else if (c == '#' && around != 1) {
-                m2[px] = '.';
-                // std::cout << "died";
-            } else {
-                m2[px] = c;
-                assert(m2.at(px) == c);
-                // std::cout << "noop";
-            }
-            // std::cout << std::endl;
+protected:
+    static uint64_t fold(Board b) noexcept
+    {
+        if constexpr (sizeof(Board) > sizeof(uint64_t)) {
+            return uint64_t(b) ^ uint64_t(b >> 64) * 0xC2B2AE3D27D4EB4FULL;
+        } else {
+            return b;
         }
     }
 
-    void add_outer(Level* l) noexcept
+    static size_t hash(Board outer, Board self, Board inner) noexcept
     {
-        assert(!outer);
-        outer = l;
-        l->inner = this;
+        const uint64_t h = (fold(self) * 0x9E3779B97F4A7C15ULL) ^ (fold(outer) * 0xFF51AFD7ED558CCDULL)
+            ^ (fold(inner) * 0xC4CEB9FE1A85EC53ULL);
+        return (h ^ (h >> 29)) >> (64 - BITS);
     }
 
-    void add_inner(Level* l) noexcept
+    std::vector<Entry> table;
+};
+
+
+// All the levels next to each other, outermost first, with an empty level
+// kept on both ends. Generations are double buffered, so all levels step in
+// parallel chunks from the frozen previous one, and the buffer is re-centred
+// when the active levels reach one of its ends.
+template<typename G>
+struct Levels
+{
+    using Board = typename G::Board;
+
+    // smallest range of levels worth a task, so the ~200 levels of the
+    // 200 minute run are already split between a few threads
+    static constexpr size_t CHUNK = 64;
+
+    Levels(Board b, bool _memo)
+        : memo {_memo}
+        , boards(16, 0)
+        , next(16, 0)
+        , lo {7}
+        , hi {10}
     {
-        assert(!inner);
-        inner = l;
-        l->outer = this;
+        boards[8] = b & ~G::HOLE_MASK;
     }
 
-    static Level* find_top(Level* me) noexcept
+    // one generation, returns the bugs in it
+    unsigned step()
     {
-        while(me->outer) {
-            me = me->outer;
+        if (lo == 0 || hi == boards.size()) {
+            grow();
         }
-        return me;
+        const unsigned bugs = tbb::parallel_reduce(
+            tbb::blocked_range<size_t>(lo, hi, CHUNK),
+            0U,
+            [this](auto const& range, unsigned cnt) {
+                const Board* from = boards.data();
+                Board* to = next.data();
+                if (memo) {
+                    auto& t = transitions.local();
+                    for (size_t i = range.begin(); i < range.end(); ++i) {
+                        to[i] = t.step(from[i - 1], from[i], from[i + 1]);
+                        cnt += G::popcount(to[i]);
+                    }
+                } else {
+                    cnt += kernel(from, to, range.begin(), range.end());
+                }
+                return cnt;
+            },
+            std::plus<unsigned> {});
+        std::swap(boards, next);
+
+        // keep an empty level on both ends
+        lo -= boards[lo] != 0;
+        hi += boards[hi - 1] != 0;
+        return bugs;
     }
 
-    static Level* find_bottom(Level* me) noexcept
+    std::pair<size_t, size_t> memo_hits() const
     {
-        while(me->inner) {
-            me = me->inner;
+        size_t hits = 0, all = 0;
+        for (auto const& t : transitions) {
+            hits += t.hits;
+            all += t.hits + t.misses;
         }
-        return me;
+        return {hits, all};
     }
 
-    static void top_to_bottom(Level* me, std::function<void(Level*)>&& op) noexcept
+    unsigned bug_count() const noexcept
     {
-        assert(me);
-        do {
-            op(me);
-            me = me->inner;
-        } while (me);
+        unsigned cnt {0};
+        for (size_t i = lo; i < hi; ++i) {
+            cnt += G::popcount(boards[i]);
+        }
+        return cnt;
     }
 
-    void dump() const noexcept
+private:
+    void grow()
     {
-        std::cout << "--------------------------------------------------------------------\n";
-        std::cout << std::hex << "outer: 0x" << outer << "\n";
-        std::cout << std::hex << "me: " << this << "\n";
-        std::cout << to_string(m1) << "\n";
-        std::cout << std::hex << "inner: 0x" << inner << "\n";
-        std::cout << "--------------------------------------------------------------------" << std::endl;
+        const size_t size = hi - lo;
+        std::vector<Board> bigger(4 * size + 16, 0);
+        const size_t start = (bigger.size() - size) / 2;
+        std::copy(boards.begin() + lo, boards.begin() + hi, bigger.begin() + start);
+        boards = std::move(bigger);
+        next.assign(boards.size(), 0);
+        lo = start;
+        hi = start + size;
     }
 
-private:
-
-    unsigned count_all(Point px, Direction d) const noexcept
+    // steps levels [first, last), returns the bugs in them
+    [[gnu::always_inline]] static inline unsigned step_range(const Board* from, Board* to, size_t first, size_t last)
     {
         unsigned cnt {0};
-
-        for (; px.x >= 0 && px.x <= MAX_X && px.y >= 0 && px.y <= MAX_Y; px = px + d) {
-            if (m1.at(px) == '#') {
-                ++cnt;
-            }
+        for (size_t i = first; i < last; ++i) {
+            to[i] = G::step(from[i - 1], from[i], from[i + 1]);
+            cnt += G::popcount(to[i]);
         }
         return cnt;
     }
 
-    Level* outer {};
-    Level* inner {};
-    Mapa m1, m2;
-
-    static constexpr int64_t MIN_X = 0, MAX_X = 4, INNER_X = 2;
-    static constexpr int64_t MIN_Y = 0, MAX_Y = 4, INNER_Y = 2;
-};
-
+    static unsigned step_range_plain(const Board* from, Board* to, size_t first, size_t last)
+    {
+        return step_range(from, to, first, last);
+    }
 
-struct Levels
-{
-    Level* add_level() noexcept {
-        levels.push_back(std::make_unique<Level>());
-        return levels.back().get();
+    // same loop, but std::popcount is one instruction instead of a libcall
+    __attribute__((target("popcnt"))) static unsigned step_range_popcnt(
+        const Board* from, Board* to, size_t first, size_t last)
+    {
+        return step_range(from, to, first, last);
     }
 
-    Level* add_level(Mapa _m) noexcept {
-        levels.push_back(std::make_unique<Level>(std::move(_m)));
-        return levels.back().get();
+    using StepRange = unsigned (*)(const Board*, Board*, size_t, size_t);
+
+    static StepRange step_range_kernel()
+    {
+        return __builtin_cpu_supports("popcnt") ? step_range_popcnt : step_range_plain;
     }
 
-private:
-    std::vector<LevelPtr> levels;
+    const bool memo;
+    const StepRange kernel = step_range_kernel();
+    tbb::enumerable_thread_specific<Transitions<G>> transitions;
+    std::vector<Board> boards, next;
+    size_t lo, hi;  // levels to step, with an empty one on both ends and around
 };
 
 
-void part2(Mapa const& mapa)
+template<typename G>
+void part2(typename G::Board b, unsigned minutes, bool memo)
 {
-    Levels levels;
-
-    Level *top = levels.add_level(std::move(mapa)), *bottom = top;
-
-    for (unsigned i = 0; i < 200; ++i) {
-
-        // top = Level::find_top(top);
-        // bottom = Level::find_bottom(top);
-
-        if (!top->empty()) {
-            Level* l = levels.add_level();
-            top->add_outer(l);
-            top = l;
-        }
-
-        if (!bottom->empty()) {
-            Level* l = levels.add_level();
-            bottom->add_inner(l);
-            bottom = l;
-        }
-
-        // top = Level::find_top(top);
-        // bottom = Level::find_bottom(top);
-
-        // std::cout << "BEFORE\n";
-        // Level::top_to_bottom(top, [](LevelPtr me) {
-        //     assert(me);
-        //     me->dump();
-        // });
-
+    Levels<G> levels(b, memo);
 
-        Level::top_to_bottom(top, [](Level* me) {
-            assert(me);
-            me->step();
-        });
-
-        Level::top_to_bottom(top, [](Level* me) {
-            assert(me);
-            me->swap_maps();
-        });
-
-        unsigned bug_count {};
-        Level::top_to_bottom(top, [&bug_count](Level* me) {
-            assert(me);
-            bug_count += me->bug_count();
-        });
-
-        // std::cout << "AFTER\n";
-        // Level::top_to_bottom(top, [](Level* me) {
-        //     assert(me);
-        //     me->dump();
-        // });
-
-        // std::cout << std::dec << "bugs @ " << i << ": " << bug_count << std::endl;
+    unsigned bugs = levels.bug_count();
+    for (unsigned i = 0; i < minutes; ++i) {
+        bugs = levels.step();
     }
 
+    if (memo) {
+        auto const [hits, all] = levels.memo_hits();
+        std::cout << "Memo hits: " << hits << " of " << all << std::endl;
+    }
 
-    // top = Level::find_top(top);
-    // auto bottom = Level::find_bottom(top);
+    std::cout << "2: " << bugs << std::endl;
+}
 
-    // Level::top_to_bottom(top, [](Level* me) {
-    //     assert(me);
-    //     me->dump();
-    // });
 
-    unsigned bug_count {};
-    Level::top_to_bottom(top, [&bug_count](Level* me) {
-        assert(me);
-        bug_count += me->bug_count();
-    });
+template<typename G>
+void run(unsigned minutes, bool memo)
+{
+    const auto b = G::load_map();
 
-    std::cout << "2: " << std::dec << bug_count << std::endl;
+    part1<G>(b);
+    part2<G>(b, minutes, memo);
 }
 
 
 int main(int argc, char* argv[])
 {
-    Mapa mapa = load_map();
-
-    part1(mapa);
-    part2(mapa);
+    // -m looks up repeated level transitions, then optional number of minutes
+    // for part 2, grid size and hole size
+    const bool memo = argc > 1 && std::string(argv[1]) == "-m";
+    const int first = memo ? 2 : 1;
+    const unsigned minutes = argc > first ? std::stoul(argv[first]) : 200;
+    const unsigned size = argc > first + 1 ? std::stoul(argv[first + 1]) : 5;
+    const unsigned hole = argc > first + 2 ? std::stoul(argv[first + 2]) : 1;
+
+    if (size == 5 && hole == 1) {
+        run<Grid<5, 1>>(minutes, memo);
+    } else if (size == 7 && hole == 1) {
+        run<Grid<7, 1>>(minutes, memo);
+    } else if (size == 7 && hole == 3) {
+        run<Grid<7, 3>>(minutes, memo);
+    } else if (size == 9 && hole == 1) {
+        run<Grid<9, 1>>(minutes, memo);
+    } else if (size == 9 && hole == 3) {
+        run<Grid<9, 3>>(minutes, memo);
+    } else {
+        std::cerr << "Unsupported grid " << size << "x" << size << " with a " << hole << "x" << hole << " hole\n";
+        return 1;
+    }
 
     return 0;
 }
-
@@ -4,12 +4,21 @@
 
 #include <cassert>
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <deque>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <list>
 #include <map>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 using Program = std::map<int64_t, int64_t>;
@@ -23,6 +32,7 @@ enum class Ret : int
 };
 
 struct Param;
+struct Journal;
 
 struct Unit
 {
@@ -32,11 +42,24 @@ struct Unit
     Program program;
     IO input, output;
 
+    uint64_t steps = 0;         // executed instructions
+    Journal* journal = nullptr; // records the consumed inputs when set
+
     Ret run();
 
+    // ASCII channel: whole lines in, whole screens out, without returning
+    // from the VM per character.
+    void feed(std::string_view line);
+    std::string_view read_until_prompt(size_t limit = 0);
+    Ret state = Ret::INPUT;
+
 protected:
     friend struct Param;
 
+    std::string ascii_in, ascii_out;
+    size_t ascii_pos = 0, ascii_limit = 0;
+    bool ascii = false;
+
     int64_t get_val(int64_t _ip);
     int64_t get_param(int64_t _ip, char mode);
     void set_param(int64_t _ip, int64_t value);
@@ -84,6 +107,47 @@ private:
     const char _mode;
 };
 
+// Consumed inputs of a session together with the instruction count at which
+// they were read, stored as LEB128 varints (step delta, zigzag value). A copy
+// of the unit is kept every CHECKPOINT inputs, so any point of the session
+// can be restored without replaying it from the start.
+struct Journal
+{
+    static constexpr size_t CHECKPOINT = 256;
+
+    struct Entry
+    {
+        uint64_t step = 0;
+        int64_t value = 0;
+    };
+
+    struct Cursor
+    {
+        size_t index = 0, pos = 0;
+        uint64_t step = 0;
+    };
+
+    void record(uint64_t step, int64_t value);
+    void checkpoint(Unit const& unit);
+    bool next(Cursor& cur, Entry& e) const;
+
+    // Unit with the first `n` inputs fed. The last one is still waiting in its
+    // input, the cursor points at it, so truncating there lets it be recorded again.
+    // nullopt when the unit asks for an input at another step than recorded.
+    std::optional<std::pair<Unit, Cursor>> seek(Unit const& start, size_t n) const;
+    void truncate(Cursor const& cur);
+
+    size_t size() const { return end.index; }
+
+    void save(std::string const& path) const;
+    static std::optional<Journal> load(std::string const& path);
+
+protected:
+    std::string log;
+    Cursor end;
+    std::vector<std::pair<Cursor, Unit>> checkpoints;
+};
+
 // template<typename T> class TD;
 
 int64_t Unit::get_val(int64_t _ip)
@@ -112,10 +176,33 @@ void Unit::set_param(int64_t _ip, int64_t value)
     program[_ip] = value;
 }
 
+void Unit::feed(std::string_view line)
+{
+    if (ascii_pos == ascii_in.size()) {
+        ascii_in.clear();
+        ascii_pos = 0;
+    }
+    ascii_in.append(line);
+    ascii_in.push_back('\n');
+}
+
+// Returns everything printed until the program wants more input. A non-ASCII
+// value (or hitting the limit) stops the run with state == Ret::OUTPUT, the
+// value itself is left in the regular output.
+std::string_view Unit::read_until_prompt(size_t limit)
+{
+    ascii_out.clear();
+    ascii_limit = limit;
+    ascii = true;
+    state = run();
+    ascii = false;
+    return ascii_out;
+}
+
 Ret Unit::run()
 {
     try {
-        for (;;) {
+        for (;; ++steps) {
             auto s = std::to_string(program.at(ip));
             std::reverse(std::begin(s), std::end(s));
             while (s.size() < 5) {
@@ -136,15 +223,33 @@ Ret Unit::run()
                 p3.set(p1() * p2());
                 ip += 4;
             } else if (cmd == "30") {
-                if (input.empty()) {
+                int64_t value;
+                if (!input.empty()) {
+                    value = input.front();
+                    input.pop_front();
+                } else if (ascii_pos < ascii_in.size()) {
+                    value = ascii_in[ascii_pos++];
+                } else {
                     return Ret::INPUT;
                 }
-                p1.set(input.front());
-                input.pop_front();
+                if (journal) {
+                    journal->record(steps, value);
+                }
+                p1.set(value);
                 ip += 2;
             } else if (cmd == "40") {
-                output.push_back(p1());
+                const auto v = p1();
                 ip += 2;
+                if (ascii && v >= 0 && v < 128) {
+                    ascii_out.push_back(v);
+                    if (ascii_limit && ascii_out.size() > ascii_limit) {
+                        ++steps;
+                        return Ret::OUTPUT;
+                    }
+                    continue;
+                }
+                output.push_back(v);
+                ++steps;
                 return Ret::OUTPUT;
             } else if (cmd == "50") {  // jump-if-true
                 if (p1()) {
@@ -181,40 +286,465 @@ Ret Unit::run()
 }
 
 
-void run1(Unit unit)
+void Journal::record(uint64_t step, int64_t value)
 {
-    for(;;) {
-        Ret ret;
-        std::string line;
-
-        while ((ret = unit.run()) == Ret::OUTPUT) {
+    auto put = [this](uint64_t v) {
+        for (; v >= 0x80; v >>= 7) {
+            log.push_back(static_cast<char>(v | 0x80));
         }
+        log.push_back(static_cast<char>(v));
+    };
+
+    assert(step >= end.step);
+    put(step - end.step);
+    put((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    end.step = step;
+    end.pos = log.size();
+    ++end.index;
+}
 
-        std::ranges::copy(unit.output, std::back_inserter(line));
-        unit.output.clear();
+void Journal::checkpoint(Unit const& unit)
+{
+    if (!checkpoints.empty() && checkpoints.back().first.index + CHECKPOINT > end.index) {
+        return;
+    }
+    auto& [_, copy] = checkpoints.emplace_back(end, unit);
+    copy.journal = nullptr;
+}
 
-        std::cout << line << std::endl;
+// false at the end of the log and on a cut off or overlong varint, the
+// cursor only moves over complete entries
+bool Journal::next(Cursor& cur, Entry& e) const
+{
+    Cursor at = cur;
+    auto get = [this, &at](uint64_t& v) -> bool {
+        v = 0;
+        for (unsigned shift = 0; shift < 64 && at.pos < log.size(); shift += 7) {
+            const auto b = static_cast<unsigned char>(log[at.pos++]);
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    uint64_t delta, z;
+    if (!get(delta) || !get(z)) {
+        return false;
+    }
+    at.step += delta;
+    e.step = at.step;
+    e.value = static_cast<int64_t>(z >> 1) ^ -static_cast<int64_t>(z & 1);
+    ++at.index;
+    cur = at;
+    return true;
+}
 
-        if (ret == Ret::EXIT) {
+std::optional<std::pair<Unit, Journal::Cursor>> Journal::seek(Unit const& start, size_t n) const
+{
+    assert(n <= size());
+
+    // the checkpoint strictly below n, so at least the last input gets replayed
+    auto it = std::lower_bound(checkpoints.begin(), checkpoints.end(), n,
+        [](auto const& cp, size_t i) { return cp.first.index < i; });
+    auto [unit, cur] = it == checkpoints.begin() ? std::pair {start, Cursor {}} : std::pair {std::prev(it)->second, std::prev(it)->first};
+    unit.journal = nullptr;
+
+    for (Entry e; cur.index < n;) {
+        const auto last = cur;
+        next(cur, e);
+        for (unit.read_until_prompt(); unit.state == Ret::OUTPUT; unit.read_until_prompt()) {
+            unit.output.clear();
+        }
+        if (unit.state != Ret::INPUT || unit.steps != e.step) {
+            std::cerr << "Journal drifted at input " << cur.index << std::endl;
+            return std::nullopt;
+        }
+        unit.input.push_back(e.value);
+        if (cur.index == n) {
+            cur = last;
             break;
         }
+    }
+    return std::pair {std::move(unit), cur};
+}
+
+void Journal::truncate(Cursor const& cur)
+{
+    log.resize(cur.pos);
+    end = cur;
+    while (!checkpoints.empty() && checkpoints.back().first.index > cur.index) {
+        checkpoints.pop_back();
+    }
+}
+
+void Journal::save(std::string const& path) const
+{
+    std::ofstream fw(path, std::ios::binary);
+    fw.write(log.data(), log.size());
+}
+
+std::optional<Journal> Journal::load(std::string const& path)
+{
+    std::ifstream fr(path, std::ios::binary);
+    if (!fr) {
+        std::cerr << "Can't read journal " << path << std::endl;
+        return std::nullopt;
+    }
 
-        assert(ret == Ret::INPUT);
+    Journal journal;
+    journal.log.assign(std::istreambuf_iterator<char>(fr), std::istreambuf_iterator<char>());
 
-        std::getline(std::cin, line);
-        line += '\n';
+    for (Entry e; journal.next(journal.end, e);) {
+    }
+    if (journal.end.pos != journal.log.size()) {
+        std::cerr << "Journal " << path << " is cut off or malformed after input " << journal.end.index << std::endl;
+        return std::nullopt;
+    }
+    return journal;
+}
+
+// Interactive session recorded into the journal, "!back" undoes the last
+// command. False when the journal doesn't replay on this program.
+bool run1(Unit const& start, Journal& journal)
+{
+    Unit unit;
+    auto rewind = [&](size_t n) -> bool {
+        auto sought = journal.seek(start, n);
+        if (!sought) {
+            return false;
+        }
+        auto& [u, cur] = *sought;
+        journal.truncate(cur);
+        unit = std::move(u);
+        unit.journal = &journal;
+        return true;
+    };
+    if (!rewind(journal.size())) {
+        return false;
+    }
+
+    std::vector<size_t> prompts; // journal size before each command
+    std::string line;
+
+    for(;;) {
+        std::cout << unit.read_until_prompt() << std::endl;
+
+        if (unit.state != Ret::INPUT || !std::getline(std::cin, line)) {
+            break;
+        }
 
         std::cout << std::endl;
 
-        unit.input.clear();
-        std::ranges::copy(line, std::back_inserter(unit.input));
-        while ((ret = unit.run()) == Ret::INPUT) {
+        if (line == "!back") {
+            if (!prompts.empty()) {
+                if (!rewind(prompts.back())) {
+                    return false;
+                }
+                prompts.pop_back();
+            }
+            continue;
+        }
+
+        journal.checkpoint(unit);
+        prompts.push_back(journal.size());
+        unit.feed(line);
+    }
+    return true;
+}
+
+
+struct Room
+{
+    std::string name;
+    std::vector<std::string> doors;
+    std::vector<std::string> items;
+};
+
+// Parse every "== Name ==" block in the game output. Usually there is one,
+// but the pressure floor ejects us back and prints two rooms in a row.
+std::vector<Room> parse_rooms(std::string_view text)
+{
+    std::vector<Room> rooms;
+    std::vector<std::string>* list = nullptr;
+
+    while (!text.empty()) {
+        const auto eol = std::min(text.find('\n'), text.size());
+        const auto line = text.substr(0, eol);
+        text.remove_prefix(std::min(eol + 1, text.size()));
+
+        if (line.size() > 6 && line.starts_with("== ") && line.ends_with(" ==")) {
+            rooms.push_back({std::string {line.substr(3, line.size() - 6)}, {}, {}});
+            list = nullptr;
+        } else if (rooms.empty()) {
+            continue;
+        } else if (line == "Doors here lead:") {
+            list = &rooms.back().doors;
+        } else if (line == "Items here:") {
+            list = &rooms.back().items;
+        } else if (list && line.starts_with("- ")) {
+            list->emplace_back(line.substr(2));
+        } else {
+            list = nullptr;
+        }
+    }
+    return rooms;
+}
+
+const std::string& reverse_door(std::string const& door)
+{
+    static const std::map<std::string, std::string> rev = {
+        {"north", "south"}, {"south", "north"}, {"east", "west"}, {"west", "east"}};
+    return rev.at(door);
+}
+
+struct Ship
+{
+    std::string start;
+    std::map<std::string, Room> rooms;
+    std::map<std::string, std::map<std::string, std::string>> graph; // room -> door -> room
+    std::map<std::string, Unit> snapshots;                           // VM standing in the room
+    std::map<std::string, std::string> safe_items;                   // item -> room
+    std::set<std::string> bad_items;
+
+    std::string checkpoint, floor, floor_door;
+};
+
+// Fork the VM, take the item and check whether we can still play afterwards.
+bool is_item_safe(Unit unit, Room const& room, std::string const& item)
+{
+    // an endless loop prints forever, give up after a few screens
+    unit.feed("take " + item);
+    unit.read_until_prompt(4096);
+    if (unit.state != Ret::INPUT) {
+        return false;
+    }
+
+    assert(!room.doors.empty());
+    unit.feed(room.doors.front());
+    auto text = unit.read_until_prompt(4096);
+    if (unit.state != Ret::INPUT) {
+        return false;
+    }
+    return !parse_rooms(text).empty();
+}
+
+// BFS over the rooms, each door is tried on a fresh copy of the VM standing in
+// the room, so we never have to walk back.
+Ship explore(Unit unit)
+{
+    Ship ship;
+
+    auto start = parse_rooms(unit.read_until_prompt());
+    assert(unit.state == Ret::INPUT);
+    assert(start.size() == 1);
+    ship.start = start.front().name;
+    ship.rooms.insert({ship.start, start.front()});
+    ship.snapshots.insert({ship.start, std::move(unit)});
+
+    std::deque<std::string> work_queue;
+    work_queue.push_back(ship.start);
+
+    while (!work_queue.empty()) {
+        const auto name = work_queue.front();
+        work_queue.pop_front();
+
+        Room const& room = ship.rooms.at(name);
+        Unit const& here = ship.snapshots.at(name);
+
+        for (auto const& item : room.items) {
+            if (is_item_safe(here, room, item)) {
+                ship.safe_items.insert({item, name});
+            } else {
+                ship.bad_items.insert(item);
+            }
+        }
+
+        auto& doors = ship.graph[name];
+        for (auto const& door : room.doors) {
+            if (doors.count(door)) {
+                continue;
+            }
+
+            Unit fork {here};
+            fork.feed(door);
+            auto rooms = parse_rooms(fork.read_until_prompt());
+            assert(fork.state == Ret::INPUT);
+            assert(!rooms.empty());
+            auto const& dest = rooms.front();
+            doors.insert({door, dest.name});
+            ship.graph[dest.name].insert({reverse_door(door), name});
+            ship.rooms.insert({dest.name, dest});
+
+            if (rooms.back().name != dest.name) {
+                // ejected back, we can't stay there with the current inventory
+                ship.checkpoint = rooms.back().name;
+                ship.floor = dest.name;
+                ship.floor_door = door;
+                continue;
+            }
+
+            if (ship.snapshots.insert({dest.name, std::move(fork)}).second) {
+                work_queue.push_back(dest.name);
+            }
         }
+    }
+
+    return ship;
+}
 
-        if (ret == Ret::EXIT) {
+
+void dump(Ship const& ship)
+{
+    for (auto const& [name, room] : ship.rooms) {
+        std::cout << name << (name == ship.start ? " (start)" : "") << "\n";
+        for (auto const& [door, dest] : ship.graph.at(name)) {
+            std::cout << "  " << std::setw(5) << std::left << door << " -> " << dest << "\n";
+        }
+        for (auto const& item : room.items) {
+            std::cout << "  * " << item << (ship.bad_items.count(item) ? " (unsafe)" : "") << "\n";
+        }
+    }
+    std::cout << "Checkpoint: " << ship.checkpoint << " -" << ship.floor_door << "-> " << ship.floor << std::endl;
+}
+
+
+// Doors to take from `from` to `to`, the pressure floor is not passable.
+std::vector<std::string> find_path(Ship const& ship, std::string const& from, std::string const& to)
+{
+    std::map<std::string, std::pair<std::string, std::string>> came_from; // room -> (prev room, door)
+    std::deque<std::string> work_queue {from};
+    came_from.insert({from, {}});
+
+    while (!work_queue.empty()) {
+        const auto name = work_queue.front();
+        work_queue.pop_front();
+        if (name == to) {
             break;
         }
+        for (auto const& [door, dest] : ship.graph.at(name)) {
+            if (dest == ship.floor || came_from.count(dest)) {
+                continue;
+            }
+            came_from.insert({dest, {name, door}});
+            work_queue.push_back(dest);
+        }
+    }
+
+    std::vector<std::string> path;
+    for (auto at = to; at != from;) {
+        auto const& [prev, door] = came_from.at(at);
+        path.push_back(door);
+        at = prev;
     }
+    std::ranges::reverse(path);
+    return path;
+}
+
+void command(Unit& unit, std::string_view cmd)
+{
+    unit.feed(cmd);
+    unit.read_until_prompt();
+    assert(unit.state == Ret::INPUT);
+}
+
+// Walk through the ship, pick up all safe items and stop at the checkpoint.
+Unit collect(Ship const& ship)
+{
+    Unit unit {ship.snapshots.at(ship.start)};
+    auto at = ship.start;
+
+    auto go = [&](std::string const& to) {
+        for (auto const& door : find_path(ship, at, to)) {
+            command(unit, door);
+        }
+        at = to;
+    };
+
+    for (auto const& [item, room] : ship.safe_items) {
+        go(room);
+        command(unit, "take " + item);
+    }
+    go(ship.checkpoint);
+
+    return unit;
+}
+
+// Try the inventories in Gray-code order, so that a step is a single take or
+// drop. The sequence is split between threads, each working on its own copy
+// of the VM. Every answer from the floor prunes all supersets ("lighter") or
+// subsets ("heavier") of the tried inventory.
+std::optional<std::string> solve(Ship const& ship)
+{
+    std::vector<std::string> items;
+    for (auto const& [item, _] : ship.safe_items) {
+        items.push_back(item);
+    }
+    assert(items.size() < 32);
+
+    const Unit start = collect(ship);
+    const uint32_t all = (1U << items.size()) - 1;
+    const uint32_t total = all + 1;
+
+    std::mutex mtx;
+    std::vector<uint32_t> too_heavy, too_light;
+    std::optional<std::string> result;
+    std::atomic<bool> found = false;
+
+    auto pruned = [&](uint32_t inv) {
+        std::lock_guard lock(mtx);
+        return std::ranges::any_of(too_heavy, [inv](uint32_t h) { return (inv & h) == h; })
+            || std::ranges::any_of(too_light, [inv](uint32_t l) { return (inv & l) == inv; });
+    };
+
+    auto worker = [&](uint32_t from, uint32_t to) {
+        Unit unit {start};
+        uint32_t held = all;
+
+        for (uint32_t i = from; i < to && !found; ++i) {
+            const uint32_t inv = i ^ (i >> 1);
+            if (pruned(inv)) {
+                continue;
+            }
+
+            for (uint32_t diff = held ^ inv; diff; diff &= diff - 1) {
+                const auto bit = std::countr_zero(diff);
+                command(unit, ((inv >> bit) & 1 ? "take " : "drop ") + items.at(bit));
+            }
+            held = inv;
+
+            Unit fork {unit};
+            fork.feed(ship.floor_door);
+            auto text = fork.read_until_prompt();
+
+            std::lock_guard lock(mtx);
+            if (text.find("are lighter than") != std::string_view::npos) {
+                too_heavy.push_back(inv);
+            } else if (text.find("are heavier than") != std::string_view::npos) {
+                too_light.push_back(inv);
+            } else {
+                assert(fork.state == Ret::EXIT);
+                auto pos = text.find("typing ");
+                if (pos != std::string_view::npos) {
+                    pos += 7;
+                    result = text.substr(pos, text.find(' ', pos) - pos);
+                }
+                found = true;
+            }
+        }
+    };
+
+    const uint32_t threads = std::clamp(std::thread::hardware_concurrency(), 1U, total);
+    std::vector<std::thread> pool;
+    for (uint32_t t = 0; t < threads; ++t) {
+        pool.emplace_back(worker, total * t / threads, total * (t + 1) / threads);
+    }
+    for (auto& th : pool) {
+        th.join();
+    }
+
+    return result;
 }
 
 
@@ -242,8 +772,37 @@ int main(int argc, char* argv[])
         }
     }
 
-    run1(unit);
-    // run2(unit);
+    // -a solves it, otherwise play; -r FILE replays a recorded session first, -w FILE records it
+    std::string record, replay;
+    bool automatic = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string opt {argv[i]};
+        if (opt == "-a") {
+            automatic = true;
+        } else if (opt == "-w" && i + 1 < argc) {
+            record = argv[++i];
+        } else if (opt == "-r" && i + 1 < argc) {
+            replay = argv[++i];
+        }
+    }
+
+    if (automatic) {
+        auto ship = explore(unit);
+        dump(ship);
+        auto code = solve(ship);
+        std::cout << "1: " << code.value_or("NOT FOUND") << std::endl;
+    } else {
+        auto journal = replay.empty() ? Journal {} : Journal::load(replay);
+        if (!journal) {
+            return 1;
+        }
+        if (!run1(unit, *journal)) {
+            return 1;
+        }
+        if (!record.empty()) {
+            journal->save(record);
+        }
+    }
 
 
     return 0;